@@ -0,0 +1,71 @@
+// map core benchmarks, build and run with make bench CONFIG=release
+#include <stdio.h>
+
+#include <SDL2/SDL_timer.h>
+
+#include "map.h"
+#include "map/insert.h"
+#include "map/query.h"
+
+#define BENCH_ROOMS 30
+#define BENCH_ROOM_SIZE 64
+#define BENCH_REPEATS 20
+#define BENCH_MAX_LOOP 1024
+
+static double secondsSince(uint64_t start)
+{
+    return (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+}
+
+// a grid of square rooms sharing their walls, inserted in one bulk pass
+static void buildRooms(Map *map)
+{
+    line_t walls[2 * BENCH_ROOMS * (BENCH_ROOMS + 1)];
+    size_t numWalls = 0;
+    for(int i = 0; i <= BENCH_ROOMS; ++i)
+    {
+        const real_t offset = i * BENCH_ROOM_SIZE;
+        for(int j = 0; j < BENCH_ROOMS; ++j)
+        {
+            const real_t start = j * BENCH_ROOM_SIZE, end = start + BENCH_ROOM_SIZE;
+            walls[numWalls++] = (line_t){ .a = { start, offset }, .b = { end, offset } };
+            walls[numWalls++] = (line_t){ .a = { offset, start }, .b = { offset, end } };
+        }
+    }
+    InsertSegmentsIntoMap(map, numWalls, walls, true);
+}
+
+// walks the face in front of every line through its half-edges, in time linear in the face's length and without allocating
+static void benchFaceWalk(Map *map)
+{
+    MapLine *loop[BENCH_MAX_LOOP];
+    size_t calls = 0, found = 0;
+
+    const uint64_t start = SDL_GetPerformanceCounter();
+    for(int r = 0; r < BENCH_REPEATS; ++r)
+    {
+        for(MapLine *line = map->headLine; line; line = line->next)
+        {
+            found += FindOuterLineLoop(line, loop, BENCH_MAX_LOOP);
+            calls++;
+        }
+    }
+    const double seconds = secondsSince(start);
+
+    printf("face walk (FindOuterLineLoop): %zu calls, %zu lines found, %.3f us per call\n", calls, found, seconds / calls * 1e6);
+}
+
+int main(void)
+{
+    Map map = { 0 };
+    NewMap(&map);
+
+    const uint64_t start = SDL_GetPerformanceCounter();
+    buildRooms(&map);
+    printf("build %dx%d rooms: %.3fs, %zu lines, %zu sectors\n", BENCH_ROOMS, BENCH_ROOMS, secondsSince(start), map.numLines, map.numSectors);
+
+    benchFaceWalk(&map);
+
+    FreeMap(&map);
+    return 0;
+}
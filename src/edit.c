@@ -8,11 +8,16 @@
 #include "triangulate.h"
 
 #include "geometry.h"
+#include "gui.h"
 #include "map.h"
 #include "map/remove.h"
 #include "map/util.h"
 #include "map/insert.h"
 #include "map/create.h"
+#include "map/faces.h"
+#include "map/grid.h"
+#include "map/hot.h"
+#include "map/tree.h"
 
 void ScreenToEditorSpace(const EdState *state, float *x, float *y)
 {
@@ -126,34 +131,15 @@ void EditRemoveVertices(Map *map, size_t num, MapVertex *vertices[static num])
 
 MapVertex* EditGetVertex(Map *map, Vec2 pos)
 {
-    for(MapVertex *vertex = map->headVertex; vertex; vertex = vertex->next)
-    {
-        if(vertex->pos.x == pos.x && vertex->pos.y == pos.y)
-        {
-            return vertex;
-        }
-    }
+    MapVertex *vertex = VertexGridFind(&map->vertexGrid, pos);
+    if(vertex && vertex->pos.x == pos.x && vertex->pos.y == pos.y)
+        return vertex;
     return NULL;
 }
 
 MapVertex* EditGetClosestVertex(Map *map, Vec2 pos, float maxDist)
 {
-    MapVertex *closestVertex = NULL;
-    float closestDist = FLT_MAX;
-    for(MapVertex *vertex = map->headVertex; vertex; vertex = vertex->next)
-    {
-        float dist2 = vec2_distance2(vertex->pos, pos);
-        if(dist2 <= maxDist*maxDist)
-        {
-            float dist = sqrt(dist2);
-            if(dist < closestDist)
-            {
-                closestDist = dist;
-                closestVertex = vertex;
-            }
-        }
-    }
-    return closestVertex;
+    return VertexGridFindClosest(&map->vertexGrid, &map->hot, pos, maxDist * maxDist);
 }
 
 MapLine* EditAddLine(Map *map, MapVertex *v0, MapVertex *v1, LineData data)
@@ -237,41 +223,22 @@ void EditRemoveLines(Map *map, size_t num, MapLine *lines[static num])
 
 MapLine* EditGetClosestLine(Map *map, Vec2 pos, float maxDist)
 {
-    MapLine *closestLine = NULL;
-    float closestDist = FLT_MAX;
-    for(MapLine *line = map->headLine; line; line = line->next)
-    {
-        float dist = MinDistToLine(line->a->pos, line->b->pos, pos);
-        if(dist <= maxDist && dist < closestDist)
-        {
-            closestDist = dist;
-            closestLine = line;
-        }
-    }
-    return closestLine;
+    return LineGridFindClosest(&map->lineGrid, &map->hot, pos, maxDist);
 }
 
+// the loop runs along lines[0] from a to b, firstFront is the side of the sector on the lines it runs along
 static void setLineSector(size_t numLines, MapLine *lines[static numLines], bool firstFront, MapSector *sector)
 {
-    MapVertex *nextVertex = firstFront ? lines[0]->b : lines[0]->a;
-    if(firstFront)
-        lines[0]->frontSector = sector;
-    else
-        lines[0]->backSector = sector;
-
-    for(size_t i = 1; i < numLines; ++i)
+    MapVertex *nextVertex = lines[0]->a;
+    for(size_t i = 0; i < numLines; ++i)
     {
         MapLine *line = lines[i];
-        if(line->a == nextVertex)
-        {
+        bool along = line->a == nextVertex;
+        nextVertex = along ? line->b : line->a;
+        if(along == firstFront)
             line->frontSector = sector;
-            nextVertex = line->b;
-        }
         else
-        {
             line->backSector = sector;
-            nextVertex = line->a;
-        }
     }
 }
 
@@ -281,22 +248,41 @@ MapSector* EditAddSector(Map *map, size_t numLines, MapLine *lines[static numLin
     if(!result.created) return result.mapElement;
     MapSector *sector = result.mapElement;
 
-    struct Polygon *polygon = PolygonFromMapLines(numLines, lines);
+    EditTriangulateSector(map, sector, numInnerLines, numInnerLinesNum, innerLines);
+
+    return sector;
+}
+
+void EditTriangulateSector(Map *map, MapSector *sector, size_t numInnerLines, size_t numInnerLinesNum[static numInnerLines], MapLine ***innerLines)
+{
+    struct Polygon *polygon = PolygonFromMapLines(sector->numOuterLines, sector->outerLines);
     orientation_t orientation = LineLoopOrientation(polygon->length, (Vec2*)polygon->vertices);
-    setLineSector(numLines, lines, orientation == CW_ORIENT, sector);
+    setLineSector(sector->numOuterLines, sector->outerLines, orientation == CW_ORIENT, sector);
+
+    // the sector keeps its holes, so removing it also clears the lines around them
+    for(size_t i = 0; i < sector->numInnerLines; ++i)
+        BlockFree(&map->elementHeap, sector->innerLines[i]);
+    BlockFree(&map->elementHeap, sector->innerLines);
+    BlockFree(&map->elementHeap, sector->numInnerLinesNum);
+    sector->innerLines = BlockAlloc(&map->elementHeap, numInnerLines * sizeof *sector->innerLines);
+    sector->numInnerLinesNum = BlockAlloc(&map->elementHeap, numInnerLines * sizeof *sector->numInnerLinesNum);
+    sector->numInnerLines = 0;
+    for(size_t i = 0; i < numInnerLines; ++i)
+    {
+        if(numInnerLinesNum[i] == 0) continue;
+        const size_t hole = sector->numInnerLines++;
+        sector->numInnerLinesNum[hole] = numInnerLinesNum[i];
+        sector->innerLines[hole] = BlockAlloc(&map->elementHeap, numInnerLinesNum[i] * sizeof **sector->innerLines);
+        memcpy(sector->innerLines[hole], innerLines[i], numInnerLinesNum[i] * sizeof **sector->innerLines);
+    }
+    numInnerLines = sector->numInnerLines;
 
     struct Polygon **innerPolygons = calloc(numInnerLines, sizeof *innerPolygons);
     for(size_t i = 0; i < numInnerLines; ++i)
     {
-        if(numInnerLinesNum[i] == 0)
-        {
-            i--;
-            numInnerLines--;
-            continue;
-        }
-        innerPolygons[i] = PolygonFromMapLines(numInnerLinesNum[i], innerLines[i]);
+        innerPolygons[i] = PolygonFromMapLines(sector->numInnerLinesNum[i], sector->innerLines[i]);
         orientation = LineLoopOrientation(innerPolygons[i]->length, (Vec2*)innerPolygons[i]->vertices);
-        setLineSector(numInnerLinesNum[i], innerLines[i], orientation == CCW_ORIENT, sector);
+        setLineSector(sector->numInnerLinesNum[i], sector->innerLines[i], orientation == CCW_ORIENT, sector);
     }
 
     TriangleData *td = &sector->edData;
@@ -304,7 +290,7 @@ MapSector* EditAddSector(Map *map, size_t numLines, MapLine *lines[static numLin
     unsigned int *indices = NULL;
     size_t numIndices = triangulate(polygon, innerPolygons, numInnerLines, &indices);
 
-    td->indices = malloc(numIndices * sizeof *indices);
+    td->indices = BlockAlloc(&map->elementHeap, numIndices * sizeof *indices);
     memcpy(td->indices, indices, numIndices * sizeof *indices);
     td->numIndices = numIndices;
     free(indices);
@@ -312,7 +298,7 @@ MapSector* EditAddSector(Map *map, size_t numLines, MapLine *lines[static numLin
     td->numVertices = polygon->length;
     for(size_t i = 0; i < numInnerLines; ++i)
         td->numVertices += innerPolygons[i]->length;
-    td->vertices = calloc(td->numVertices, sizeof *td->vertices);
+    td->vertices = BlockAlloc(&map->elementHeap, td->numVertices * sizeof *td->vertices);
     memcpy(td->vertices, polygon->vertices, polygon->length * sizeof *polygon->vertices);
     size_t offset = polygon->length;
     for(size_t i = 0; i < numInnerLines; ++i)
@@ -321,14 +307,26 @@ MapSector* EditAddSector(Map *map, size_t numLines, MapLine *lines[static numLin
         offset += innerPolygons[i]->length;
     }
 
+    BlockFree(&map->elementHeap, sector->rings);
+    sector->numRings = 1 + numInnerLines;
+    sector->rings = BlockAlloc(&map->elementHeap, sector->numRings * sizeof *sector->rings);
+    sector->rings[0] = (SectorRing){ .offset = 0, .length = polygon->length };
+    for(size_t i = 0; i < numInnerLines; ++i)
+    {
+        SectorRing prev = sector->rings[i];
+        sector->rings[i + 1] = (SectorRing){ .offset = prev.offset + prev.length, .length = innerPolygons[i]->length };
+    }
+    for(size_t i = 0; i < sector->numRings; ++i)
+        sector->rings[i].bb = BoundingBoxFromVertices(sector->rings[i].length, td->vertices + sector->rings[i].offset);
+
     free(polygon);
     for(size_t i = 0; i < numInnerLines; ++i)
         free(innerPolygons[i]);
     free(innerPolygons);
 
     sector->bb = BoundingBoxFromVertices(td->numVertices, td->vertices);
-
-    return sector;
+    HotUpdateSector(&map->hot, sector);
+    SectorTreeUpdate(&map->sectorTree, sector);
 }
 
 void EditRemoveSectors(Map *map, size_t num, MapSector *sectors[static num])
@@ -344,22 +342,76 @@ void EditRemoveSectors(Map *map, size_t num, MapSector *sectors[static num])
 
 MapSector* EditGetSector(Map *map, Vec2 pos)
 {
-    for(MapSector *sector = map->headSector; sector; sector = sector->next)
+    return SectorTreePick(&map->sectorTree, pos);
+}
+
+// each drawn line can be cut by every other one and every map line, requeued pieces are counted a few times over
+#define INSERT_STEPS_PER_PIECE 4
+
+typedef struct InsertBudget
+{
+    size_t maxSteps;
+} InsertBudget;
+
+static InsertBudget insertBudget(const Map *map, size_t numLines)
+{
+    return (InsertBudget){ .maxSteps = INSERT_STEPS_PER_PIECE * numLines * (numLines + map->numLines + 1) };
+}
+
+static bool insertProgress(size_t processed, size_t pending, void *user)
+{
+    const InsertBudget *budget = user;
+    // only a runaway insert that keeps splitting the same lines gets past the budget
+    if(processed >= budget->maxSteps)
     {
-        bool isIn = PointInSector2(sector, pos);
-        if(isIn) return sector;
+        LogError("Inserting lines: stopped after %zu steps with %zu pending, the map was left unchanged", processed, pending);
+        return false;
     }
-    return NULL;
+    if(!GuiProgress("Inserting lines", processed, pending))
+    {
+        LogInfo("Inserting lines: cancelled, the map was left unchanged");
+        return false;
+    }
+    return true;
+}
+
+static bool insertLines(Map *map, size_t num, Vec2 points[static num], bool isLoop)
+{
+    InsertBudget budget = insertBudget(map, num);
+    bool ok = InsertLinesIntoMap(map, num, points, isLoop, insertProgress, &budget);
+    GuiProgressEnd();
+    return ok;
+}
+
+// splits can free selected lines and sectors, selected vertices stay
+static void clearSplitSelection(EdState *state)
+{
+    if(state->data.selectionMode != MODE_VERTEX)
+        SelectionClear(state);
 }
 
 bool EditApplyLines(EdState *state, size_t num, Vec2 points[static num])
 {
-    Map *map = &state->map;
-    return InsertLinesIntoMap(map, num, points, false);
+    clearSplitSelection(state);
+    return insertLines(&state->map, num, points, false);
 }
 
 bool EditApplySector(EdState *state, size_t num, Vec2 points[static num])
 {
-    Map *map = &state->map;
-    return InsertLinesIntoMap(map, num, points, true);
+    clearSplitSelection(state);
+    return insertLines(&state->map, num, points, true);
+}
+
+bool EditApplySegments(EdState *state, size_t num, line_t segments[static num], bool makeSectors)
+{
+    clearSplitSelection(state);
+    return InsertSegmentsIntoMap(&state->map, num, segments, makeSectors);
+}
+
+void EditRebuildSectors(EdState *state)
+{
+    // sectors that no longer match their face are freed
+    if(state->data.selectionMode == MODE_SECTOR)
+        SelectionClear(state);
+    RebuildMapSectors(&state->map);
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "editor.h"
+#include "geometry.h"
 #include "vecmath.h"
 
 void ScreenToEditorSpace(const EdState *state, float *x, float *y);
@@ -22,8 +23,13 @@ void EditRemoveLines(Map *map, size_t num, MapLine *lines[static num]);
 MapLine* EditGetClosestLine(Map *map, Vec2 pos, float maxDist);
 
 MapSector* EditAddSector(Map *map, size_t numLines, MapLine *lines[static numLines], size_t numInnerLines, size_t numInnerLinesNum[static numInnerLines], MapLine ***innerLines, SectorData data);
+// orients the sector's lines and builds its render triangles
+void EditTriangulateSector(Map *map, MapSector *sector, size_t numInnerLines, size_t numInnerLinesNum[static numInnerLines], MapLine ***innerLines);
 void EditRemoveSectors(Map *map, size_t num, MapSector *sectors[static num]);
 MapSector* EditGetSector(Map *map, Vec2 pos);
 
 bool EditApplyLines(EdState *state, size_t num, Vec2 points[static num]);
 bool EditApplySector(EdState *state, size_t num, Vec2 points[static num]);
+bool EditApplySegments(EdState *state, size_t num, line_t segments[static num], bool makeSectors);
+// makes a sector for every enclosed area of the map, for after imports and bulk edits
+void EditRebuildSectors(EdState *state);
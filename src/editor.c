@@ -10,8 +10,10 @@
 #include "texture_collection.h"
 #include "resources/resources.h"
 #include "vertex_types.h"
+#include "map/grid.h"
+#include "map/tree.h"
 
-#define SELECTION_CAPACITY 10000
+#define SELECTION_MIN_CAPACITY 1024
 #define BUFFER_SIZE (1<<20)
 #define TEXTURE_SET_SIZE 8192
 #define WHITE_TEXTURE (TEXTURE_SET_SIZE - 1)
@@ -148,7 +150,8 @@ bool InitEditor(EdState *state, char *error, size_t errorSize)
 
     state->data.autoScrollLogs = true;
 
-    state->data.selectedElements = calloc(SELECTION_CAPACITY, sizeof *state->data.selectedElements);
+    state->data.selectionCapacity = SELECTION_MIN_CAPACITY;
+    state->data.selectedElements = calloc(state->data.selectionCapacity, sizeof *state->data.selectedElements);
 
     return true;
 }
@@ -176,6 +179,7 @@ void DestroyEditor(EdState *state)
     glDeleteProgram(state->gl.realtimeProgram.program);
 
     free(state->data.selectedElements);
+    free(state->data.textureCache);
 }
 
 void ResizeEditorView(EdState *state, int width, int height)
@@ -218,11 +222,72 @@ void ChangeMode(EdState *state, enum SelectionMode mode)
 {
     if(state->data.selectionMode != (int)mode)
     {
+        SelectionClear(state);
         state->data.selectionMode = mode;
-        state->data.numSelectedElements = 0;
     }
 }
 
+static bool* selectedFlag(const EdState *state, const void *element)
+{
+    switch(state->data.selectionMode)
+    {
+    case MODE_VERTEX: return &((MapVertex*)element)->selected;
+    case MODE_LINE: return &((MapLine*)element)->selected;
+    case MODE_SECTOR: return &((MapSector*)element)->selected;
+    }
+    return NULL;
+}
+
+void SelectionAdd(EdState *state, void *element)
+{
+    bool *selected = selectedFlag(state, element);
+    if(*selected) return;
+
+    if(state->data.numSelectedElements == state->data.selectionCapacity)
+    {
+        state->data.selectionCapacity *= 2;
+        state->data.selectedElements = realloc(state->data.selectedElements, state->data.selectionCapacity * sizeof *state->data.selectedElements);
+    }
+    state->data.selectedElements[state->data.numSelectedElements++] = element;
+    *selected = true;
+}
+
+void SelectionRemove(EdState *state, void *element)
+{
+    bool *selected = selectedFlag(state, element);
+    if(!*selected) return;
+
+    for(size_t i = 0; i < state->data.numSelectedElements; ++i)
+    {
+        if(state->data.selectedElements[i] == element)
+        {
+            memmove(state->data.selectedElements + i, state->data.selectedElements + i + 1, (state->data.numSelectedElements - (i+1)) * sizeof *state->data.selectedElements);
+            state->data.numSelectedElements--;
+            break;
+        }
+    }
+    *selected = false;
+}
+
+bool SelectionContains(const EdState *state, const void *element)
+{
+    return *selectedFlag(state, element);
+}
+
+void SelectionClear(EdState *state)
+{
+    for(size_t i = 0; i < state->data.numSelectedElements; ++i)
+    {
+        *selectedFlag(state, state->data.selectedElements[i]) = false;
+    }
+    state->data.numSelectedElements = 0;
+}
+
+void ClearTextureCache(EdState *state)
+{
+    memset(state->data.textureCache, 0, state->data.textureCacheSize * sizeof *state->data.textureCache);
+}
+
 static void RenderBackground(const EdState *state)
 {
     const float period = state->data.gridSize * state->data.zoomLevel;
@@ -279,174 +344,220 @@ static void RenderBackground(const EdState *state)
     }
 }
 
-static inline bool includes(void * const *list, size_t size, const void *element)
+typedef struct RenderData
+{
+    GLuint texture;
+    size_t vertexOffset;
+    size_t indexOffset;
+    size_t indexCount;
+} RenderData;
+
+typedef struct CollectData
+{
+    const EdState *state;
+    size_t vertexOffset, verts;
+
+    // sectors only
+    size_t indexOffset, inds;
+    RenderData *renderData, *rd;
+    size_t renderDataSize, currentRenderData;
+    GLuint currentTexture;
+    GLuint *texCache;
+} CollectData;
+
+// world space rectangle covered by the editor view, padded so points and line decorations at the edges are kept
+static BoundingBox visibleArea(const EdState *state)
+{
+    const float z = state->data.zoomLevel;
+    const float pad = max(state->settings.vertexPointSize, 8.0f) / z;
+    return (BoundingBox){
+        .min = { .x = state->data.viewPosition.x / z - pad, .y = state->data.viewPosition.y / z - pad },
+        .max = { .x = (state->data.viewPosition.x + state->gl.editorFramebufferWidth) / z + pad, .y = (state->data.viewPosition.y + state->gl.editorFramebufferHeight) / z + pad }
+    };
+}
+
+static void collectVertex(void *element, void *user)
 {
-    for(size_t i = 0; i < size; ++i)
+    CollectData *cd = user;
+    const EdState *state = cd->state;
+    const MapVertex *vertex = element;
+    int colorIdx = COL_VERTEX;
+    if(vertex->selected)
     {
-        if(list[i] == element) return true;
+        colorIdx = COL_VERTEX_SELECT;
     }
-    return false;
+    else if(vertex == state->data.hoveredElement)
+    {
+        colorIdx = COL_VERTEX_HOVER;
+    }
+
+    state->gl.editorVertexMap[cd->verts + cd->vertexOffset] = (EditorVertexType){ .position = vertex->pos, .color = state->settings.colors[colorIdx] };
+    cd->verts++;
 }
 
 static size_t CollectVertices(const EdState *state, size_t vertexOffset)
 {
-    size_t verts = 0;
-    for(const MapVertex *vertex = state->map.headVertex; vertex; vertex = vertex->next)
+    CollectData cd = { .state = state, .vertexOffset = vertexOffset };
+    VertexGridQueryBox(&state->map.vertexGrid, &state->map.hot, visibleArea(state), collectVertex, &cd);
+    return cd.verts;
+}
+
+static void collectLine(void *element, void *user)
+{
+    CollectData *cd = user;
+    const EdState *state = cd->state;
+    const MapHotData *hot = &state->map.hot;
+    const MapLine *line = element;
+    const Vec2 a = hot->lineA[line->slot], b = hot->lineB[line->slot];
+    const size_t verts = cd->verts, vertexOffset = cd->vertexOffset;
+    int colorIdx = COL_LINE;
+    if(line->frontSector && line->backSector)
     {
-        int colorIdx = COL_VERTEX;
-        if(state->data.numSelectedElements > 0 && includes(state->data.selectedElements, state->data.numSelectedElements, vertex))
+        colorIdx = COL_LINE_INNER;
+    }
+    if(state->data.selectionMode == MODE_LINE)
+    {
+        if(line->selected)
         {
-            colorIdx = COL_VERTEX_SELECT;
+            colorIdx = COL_LINE_SELECT;
         }
-        else if(vertex == state->data.hoveredElement)
+        else if(line == state->data.hoveredElement)
         {
-            colorIdx = COL_VERTEX_HOVER;
+            colorIdx = COL_LINE_HOVER;
         }
-
-        state->gl.editorVertexMap[verts + vertexOffset] = (EditorVertexType){ .position = vertex->pos, .color = state->settings.colors[colorIdx] };
-        verts++;
     }
-    return verts;
-}
-
-static size_t CollectLines(const EdState *state, size_t vertexOffset)
-{
-    size_t verts = 0;
-    for(const MapLine *line = state->map.headLine; line; line = line->next)
+    else if(state->data.selectionMode == MODE_SECTOR)
     {
-        int colorIdx = COL_LINE;
-        if(line->frontSector && line->backSector)
+        // a line bounds exactly the sectors on its sides, its outline and the rims of its holes
+        const MapSector *hovered = state->data.hoveredElement;
+        const MapSector *front = line->frontSector, *back = line->backSector;
+        if(hovered && (front == hovered || back == hovered))
         {
-            colorIdx = COL_LINE_INNER;
+            colorIdx = COL_LINE_HOVER;
         }
-        if(state->data.selectionMode == MODE_LINE)
+        else if((front && front->selected) || (back && back->selected))
         {
-            if(state->data.numSelectedElements > 0 && includes(state->data.selectedElements, state->data.numSelectedElements, line))
-            {
-                colorIdx = COL_LINE_SELECT;
-            }
-            else if(line == state->data.hoveredElement)
-            {
-                colorIdx = COL_LINE_HOVER;
-            }
-        }
-        else if(state->data.selectionMode == MODE_SECTOR)
-        {
-            if(state->data.hoveredElement)
-            {
-                MapSector *sector = state->data.hoveredElement;
-                if(includes((void**)sector->outerLines, sector->numOuterLines, line))
-                {
-                    colorIdx = COL_LINE_HOVER;
-                    goto foundColIdx;
-                }
-            }
-            for(size_t i = 0; i < state->data.numSelectedElements; ++i)
-            {
-                MapSector *sector = state->data.selectedElements[i];
-                if(includes((void**)sector->outerLines, sector->numOuterLines, line))
-                {
-                    colorIdx = COL_LINE_SELECT;
-                    break;
-                }
-            }
-foundColIdx:
+            colorIdx = COL_LINE_SELECT;
         }
+    }
 
-        Color color = state->settings.colors[colorIdx];
-        size_t relVertIdx = 0;
-        state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = line->a->pos, .color = color };
-        state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = line->b->pos, .color = color };
+    Color color = state->settings.colors[colorIdx];
+    size_t relVertIdx = 0;
+    state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = a, .color = color };
+    state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = b, .color = color };
 
-        Vec2 dir = vec2_sub(line->b->pos, line->a->pos);
-        Vec2 normalStart = vec2_add(line->a->pos, vec2_scale(dir, 0.5f));
-        Vec2 perpDir = vec2_normalize((Vec2){ .x = -dir.y, .y = dir.x });
+    Vec2 dir = vec2_sub(b, a);
+    Vec2 normalStart = vec2_add(a, vec2_scale(dir, 0.5f));
+    Vec2 perpDir = vec2_normalize((Vec2){ .x = -dir.y, .y = dir.x });
 
-        float inverseZoom = 1.0f / (state->data.zoomLevel);
-        float normalLength = 6;
-        Vec2 normalEnd = vec2_add(normalStart, vec2_scale(perpDir, normalLength * inverseZoom));
+    float inverseZoom = 1.0f / (state->data.zoomLevel);
+    float normalLength = 6;
+    Vec2 normalEnd = vec2_add(normalStart, vec2_scale(perpDir, normalLength * inverseZoom));
 
-        state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = normalStart, .color = color };
-        state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = normalEnd, .color = color };
+    state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = normalStart, .color = color };
+    state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = normalEnd, .color = color };
 
-        if(state->settings.showLineDir)
-        {
-            float arrowHeadThickness = 6;
-            float arrowHeadHeight = 8;
-            Vec2 endPoint = vec2_sub(line->b->pos, vec2_scale(vec2_normalize(dir), arrowHeadHeight));
-            Vec2 invPerpDir = { .x = -perpDir.x, .y = -perpDir.y };
-            Vec2 arrowHeadLeft = vec2_add(endPoint, vec2_scale(invPerpDir, arrowHeadThickness));
-            Vec2 arrowHeadRight = vec2_add(endPoint, vec2_scale(perpDir, arrowHeadThickness));
-
-            state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = line->b->pos, .color = color };
-            state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = arrowHeadLeft, .color = color };
-
-            state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = line->b->pos, .color = color };
-            state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = arrowHeadRight, .color = color };
-        }
-        verts += relVertIdx;
+    if(state->settings.showLineDir)
+    {
+        float arrowHeadThickness = 6;
+        float arrowHeadHeight = 8;
+        Vec2 endPoint = vec2_sub(b, vec2_scale(vec2_normalize(dir), arrowHeadHeight));
+        Vec2 invPerpDir = { .x = -perpDir.x, .y = -perpDir.y };
+        Vec2 arrowHeadLeft = vec2_add(endPoint, vec2_scale(invPerpDir, arrowHeadThickness));
+        Vec2 arrowHeadRight = vec2_add(endPoint, vec2_scale(perpDir, arrowHeadThickness));
+
+        state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = b, .color = color };
+        state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = arrowHeadLeft, .color = color };
+
+        state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = b, .color = color };
+        state->gl.editorVertexMap[verts + vertexOffset + relVertIdx++] = (EditorVertexType){ .position = arrowHeadRight, .color = color };
     }
-    return verts;
+    cd->verts += relVertIdx;
 }
 
-typedef struct RenderData
+static size_t CollectLines(EdState *state, size_t vertexOffset)
 {
-    GLuint texture;
-    size_t vertexOffset;
-    size_t indexOffset;
-    size_t indexCount;
-} RenderData;
+    CollectData cd = { .state = state, .vertexOffset = vertexOffset };
+    LineGridQueryBox(&state->map.lineGrid, visibleArea(state), collectLine, &cd);
+    return cd.verts;
+}
 
-static size_t CollectSectors(const EdState *state, size_t vertexOffset, size_t indexOffset, RenderData *renderData, size_t renderDataSize, size_t *numTextures)
+static void collectSector(void *element, void *user)
 {
-    size_t verts = 0, inds = 0, currentRenderData = 0;
-    GLuint currentTexture = 0;
-    RenderData *rd = &renderData[0];
-    for(const MapSector *sector = state->map.headSector; sector; sector = sector->next)
-    {
-        int colorIdx = COL_SECTOR;
-        /*
-        if(state->data.numSelectedElements > 0 && includes(state->data.selectedElements, state->data.numSelectedElements, sector))
-        {
-            colorIdx = COL_SECTOR_SELECT;
-        }
-        else*/ if(sector == state->data.hoveredElement)
-        {
-            colorIdx = COL_SECTOR_HOVER;
-        }
-        const Texture *texture = tc_get(&state->textures, sector->data.floorTex);
-        GLuint texId = texture ? texture->texture1 : state->defaultTextures.missingTexture;
-        if(texId != currentTexture)
-        {
-            currentRenderData++;
-            assert(currentRenderData < renderDataSize);
-            currentTexture = texId;
-            rd = &renderData[currentRenderData-1];
-            rd->indexOffset = indexOffset + inds;
-            rd->vertexOffset = vertexOffset + verts;
-            rd->texture = texId;
-        }
+    CollectData *cd = user;
+    const EdState *state = cd->state;
+    const MapSector *sector = element;
+    int colorIdx = COL_SECTOR;
+    /*
+    if(sector->selected)
+    {
+        colorIdx = COL_SECTOR_SELECT;
+    }
+    else*/ if(sector == state->data.hoveredElement)
+    {
+        colorIdx = COL_SECTOR_HOVER;
+    }
+    GLuint texId = cd->texCache[sector->data.floorTex];
+    if(texId == 0)
+    {
+        const Texture *texture = tc_get(&state->textures, InternedString(sector->data.floorTex));
+        texId = texture ? texture->texture1 : state->defaultTextures.missingTexture;
+        cd->texCache[sector->data.floorTex] = texId;
+    }
+    if(texId != cd->currentTexture)
+    {
+        cd->currentRenderData++;
+        assert(cd->currentRenderData < cd->renderDataSize);
+        cd->currentTexture = texId;
+        cd->rd = &cd->renderData[cd->currentRenderData-1];
+        cd->rd->indexOffset = cd->indexOffset + cd->inds;
+        cd->rd->vertexOffset = cd->vertexOffset + cd->verts;
+        cd->rd->texture = texId;
+    }
 
-        const TriangleData data = sector->edData;
-        for(size_t i = 0; i < data.numIndices; ++i)
-        {
-            state->gl.editorIndexMap[indexOffset + inds + i] = data.indices[i] + verts;
-        }
-        inds += data.numIndices;
-        rd->indexCount += data.numIndices;
+    const TriangleData data = sector->edData;
+    for(size_t i = 0; i < data.numIndices; ++i)
+    {
+        state->gl.editorIndexMap[cd->indexOffset + cd->inds + i] = data.indices[i] + cd->verts;
+    }
+    cd->inds += data.numIndices;
+    cd->rd->indexCount += data.numIndices;
 
-        size_t offsetIndex = verts + vertexOffset;
-        for(size_t i = 0; i < data.numVertices; i++)
-        {
-            const Vec2 position = data.vertices[i];
-            const Vec2 texcoord = vec2_scale(data.vertices[i], 1.0f / state->map.textureScale);
-            
-            state->gl.editorVertexMap[i + offsetIndex] = (EditorVertexType){ .position = position, .texCoord = texcoord, .color = state->settings.colors[colorIdx] };
-        }
-        verts += data.numVertices;
+    size_t offsetIndex = cd->verts + cd->vertexOffset;
+    for(size_t i = 0; i < data.numVertices; i++)
+    {
+        const Vec2 position = data.vertices[i];
+        const Vec2 texcoord = vec2_scale(data.vertices[i], 1.0f / state->map.textureScale);
+        
+        state->gl.editorVertexMap[i + offsetIndex] = (EditorVertexType){ .position = position, .texCoord = texcoord, .color = state->settings.colors[colorIdx] };
+    }
+    cd->verts += data.numVertices;
+}
+
+static size_t CollectSectors(EdState *state, size_t vertexOffset, size_t indexOffset, RenderData *renderData, size_t renderDataSize, size_t *numTextures)
+{
+    // names interned since the last frame get fresh entries
+    const size_t numIds = InternedCount() + 1;
+    if(state->data.textureCacheSize < numIds)
+    {
+        state->data.textureCache = realloc(state->data.textureCache, numIds * sizeof *state->data.textureCache);
+        memset(state->data.textureCache + state->data.textureCacheSize, 0, (numIds - state->data.textureCacheSize) * sizeof *state->data.textureCache);
+        state->data.textureCacheSize = numIds;
     }
-    *numTextures = currentRenderData;
-    return verts;
+
+    CollectData cd =
+    {
+        .state = state,
+        .vertexOffset = vertexOffset,
+        .indexOffset = indexOffset,
+        .renderData = renderData,
+        .rd = &renderData[0],
+        .renderDataSize = renderDataSize,
+        .texCache = state->data.textureCache
+    };
+    SectorTreeQueryBox(&state->map.sectorTree, visibleArea(state), collectSector, &cd);
+    *numTextures = cd.currentRenderData;
+    return cd.verts;
 }
 
 static size_t CollectDragData(const EdState *state, size_t vertexOffset)
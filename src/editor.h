@@ -254,8 +254,12 @@ typedef struct EdState
         EditState editState;
 
         void **selectedElements;
-        size_t numSelectedElements;
+        size_t numSelectedElements, selectionCapacity;
         void *hoveredElement;
+
+        // floor texture per interned name, 0 until looked up, cleared whenever the texture collection changes
+        GLuint *textureCache;
+        size_t textureCacheSize;
     } data;
 
     struct {
@@ -284,6 +288,12 @@ void FreeSettings(EdSettings *settings);
 bool LoadShaders(EdState *state, char *error, size_t errorSize);
 
 void ChangeMode(EdState *state, enum SelectionMode mode);
+void SelectionAdd(EdState *state, void *element);
+void SelectionRemove(EdState *state, void *element);
+bool SelectionContains(const EdState *state, const void *element);
+void SelectionClear(EdState *state);
+
+void ClearTextureCache(EdState *state);
 
 bool InitEditor(EdState *state, char *error, size_t errorSize);
 void DestroyEditor(EdState *state);
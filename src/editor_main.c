@@ -277,6 +277,7 @@ int EditorMain(int argc, char *argv[])
     DestroyEditor(state);
 
     ScriptDestroy(&state->script);
+    InternFree();
 
     LogDestroy(&state->log);
 
@@ -14,14 +14,17 @@ bool PointInSector(MapSector *sector, Vec2 point)
 
 bool PointInSector2(MapSector *sector, Vec2 point)
 {
-    bool inside = PointInSector(sector, point);
-    for(size_t i = 0; i < sector->numInnerLines; ++i)
+    if(sector->numRings == 0) return PointInSector(sector, point);
+
+    for(size_t i = 0; i < sector->numRings; ++i)
     {
-        struct Polygon *poly = PolygonFromMapLines(sector->numInnerLinesNum[i], sector->innerLines[i]);
-        inside &= !PointInPolygon(poly, point);
-        free(poly);
+        const SectorRing *ring = &sector->rings[i];
+        bool inBB = point.x >= ring->bb.min.x && point.x <= ring->bb.max.x && point.y >= ring->bb.min.y && point.y <= ring->bb.max.y;
+        bool inRing = inBB && PointInPolygonVector(ring->length, sector->edData.vertices + ring->offset, point);
+        // inside the outer loop and outside every hole
+        if(inRing != (i == 0)) return false;
     }
-    return inside;
+    return true;
 }
 
 bool PointInPolygon(struct Polygon *polygon, Vec2 point)
@@ -29,31 +32,36 @@ bool PointInPolygon(struct Polygon *polygon, Vec2 point)
     return PointInPolygonVector(polygon->length, (Vec2*)polygon->vertices, point);
 }
 
-bool PointInPolygonVector(size_t numVertices, Vec2 vertices[static numVertices], Vec2 point)
+// scalar edge test shared by all kernels, returns false once the point is found on the boundary of the edge
+static inline bool pointInPolygonEdge(Vec2 A, Vec2 B, Vec2 point, bool *inside)
 {
-    bool inside = false;
-    for(size_t i = 0; i < numVertices; ++i)
+    if ((eq(point.x, A.x) && eq(point.y, A.y)) || (eq(point.x, B.x) && eq(point.y, B.y))) return false;
+    if (eq(A.y, B.y) && eq(point.y, A.y) && between(point.x, A.x, B.x)) return false;
+
+    if (between(point.y, A.y, B.y))
+    { // if P inside the vertical range
+        // filter out "ray pass vertex" problem by treating the line a little lower
+        if ((eq(point.y, A.y) && B.y >= A.y) || (eq(point.y, B.y) && A.y >= B.y)) return true;
+        // calc cross product `PA X PB`, P lays on left side of AB if c > 0
+        real_t c = (A.x - point.x) * (B.y - point.y) - (B.x - point.x) * (A.y - point.y);
+        if (c == 0) return false;
+        if ((A.y < B.y) == (c > 0)) *inside = !*inside;
+    }
+    return true;
+}
+
+// continues the edge loop at edge `start`
+static bool pointInPolygonScalar(size_t numVertices, const Vec2 vertices[], Vec2 point, size_t start, bool inside)
+{
+    for(size_t i = start; i < numVertices; ++i)
     {
-        Vec2 A = vertices[i];
-        Vec2 B = vertices[(i+1) % numVertices];
-
-        if ((eq(point.x, A.x) && eq(point.y, A.y)) || (eq(point.x, B.x) && eq(point.y, B.y))) break;
-        if (eq(A.y, B.y) && eq(point.y, A.y) && between(point.x, A.x, B.x)) break;
-
-        if (between(point.y, A.y, B.y))
-        { // if P inside the vertical range
-            // filter out "ray pass vertex" problem by treating the line a little lower
-            if ((eq(point.y, A.y) && B.y >= A.y) || (eq(point.y, B.y) && A.y >= B.y)) continue;
-            // calc cross product `PA X PB`, P lays on left side of AB if c > 0
-            real_t c = (A.x - point.x) * (B.y - point.y) - (B.x - point.x) * (A.y - point.y);
-            if (c == 0) break;
-            if ((A.y < B.y) == (c > 0)) inside = !inside;
-        }
+        if(!pointInPolygonEdge(vertices[i], vertices[(i+1) % numVertices], point, &inside))
+            break;
     }
     return inside;
 }
 
-real_t MinDistToLine(Vec2 a, Vec2 b, Vec2 point)
+static inline real_t minDistToLineScalar(Vec2 a, Vec2 b, Vec2 point)
 {
     real_t l2 = vec2_distance2(a, b);
     if(eq(l2, 0)) return vec2_distance2(point, a);
@@ -63,6 +71,219 @@ real_t MinDistToLine(Vec2 a, Vec2 b, Vec2 point)
     return vec2_distance(point, tmp);
 }
 
+static bool pointInPolygonGeneric(size_t numVertices, const Vec2 vertices[], Vec2 point)
+{
+    return pointInPolygonScalar(numVertices, vertices, point, 0, false);
+}
+
+static void minDistToLinesGeneric(size_t num, const Vec2 a[], const Vec2 b[], Vec2 point, real_t dists[])
+{
+    for(size_t i = 0; i < num; ++i)
+        dists[i] = minDistToLineScalar(a[i], b[i], point);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// The kernels below compute the same per edge conditions as pointInPolygonEdge for several edges at once.
+// An edge breaks the loop if the point lies on it, the parity only counts the toggles before the first such edge.
+
+static inline bool finishBlock(int breakMask, int toggleMask, unsigned *parity)
+{
+    if(breakMask)
+    {
+        toggleMask &= (1 << __builtin_ctz(breakMask)) - 1;
+        *parity += __builtin_popcount(toggleMask);
+        return true;
+    }
+    *parity += __builtin_popcount(toggleMask);
+    return false;
+}
+
+static bool pointInPolygonSSE2(size_t numVertices, const Vec2 vertices[], Vec2 point)
+{
+    const __m128d px = _mm_set1_pd(point.x), py = _mm_set1_pd(point.y);
+    const __m128d eps = _mm_set1_pd(EPSILON), signBit = _mm_set1_pd(-0.0), zero = _mm_setzero_pd();
+    unsigned parity = 0;
+    size_t i = 0;
+    for(; i + 2 < numVertices; i += 2)
+    {
+        __m128d a0 = _mm_loadu_pd(&vertices[i].x), a1 = _mm_loadu_pd(&vertices[i+1].x), a2 = _mm_loadu_pd(&vertices[i+2].x);
+        __m128d ax = _mm_unpacklo_pd(a0, a1), ay = _mm_unpackhi_pd(a0, a1);
+        __m128d bx = _mm_unpacklo_pd(a1, a2), by = _mm_unpackhi_pd(a1, a2);
+
+        __m128d eqPAx = _mm_cmple_pd(_mm_andnot_pd(signBit, _mm_sub_pd(px, ax)), eps);
+        __m128d eqPAy = _mm_cmple_pd(_mm_andnot_pd(signBit, _mm_sub_pd(py, ay)), eps);
+        __m128d eqPBx = _mm_cmple_pd(_mm_andnot_pd(signBit, _mm_sub_pd(px, bx)), eps);
+        __m128d eqPBy = _mm_cmple_pd(_mm_andnot_pd(signBit, _mm_sub_pd(py, by)), eps);
+        __m128d eqAB = _mm_cmple_pd(_mm_andnot_pd(signBit, _mm_sub_pd(ay, by)), eps);
+
+        __m128d onVertex = _mm_or_pd(_mm_and_pd(eqPAx, eqPAy), _mm_and_pd(eqPBx, eqPBy));
+        __m128d betweenX = _mm_or_pd(_mm_and_pd(_mm_cmpge_pd(px, ax), _mm_cmple_pd(px, bx)), _mm_and_pd(_mm_cmple_pd(px, ax), _mm_cmpge_pd(px, bx)));
+        __m128d onHorizontal = _mm_and_pd(_mm_and_pd(eqAB, eqPAy), betweenX);
+        __m128d inRange = _mm_or_pd(_mm_and_pd(_mm_cmpge_pd(py, ay), _mm_cmple_pd(py, by)), _mm_and_pd(_mm_cmple_pd(py, ay), _mm_cmpge_pd(py, by)));
+        __m128d skip = _mm_or_pd(_mm_and_pd(eqPAy, _mm_cmpge_pd(by, ay)), _mm_and_pd(eqPBy, _mm_cmpge_pd(ay, by)));
+        __m128d c = _mm_sub_pd(_mm_mul_pd(_mm_sub_pd(ax, px), _mm_sub_pd(by, py)), _mm_mul_pd(_mm_sub_pd(bx, px), _mm_sub_pd(ay, py)));
+        __m128d crossing = _mm_andnot_pd(skip, inRange);
+        __m128d cZero = _mm_cmpeq_pd(c, zero);
+
+        __m128d brk = _mm_or_pd(_mm_or_pd(onVertex, onHorizontal), _mm_and_pd(crossing, cZero));
+        __m128d sameSide = _mm_xor_pd(_mm_cmplt_pd(ay, by), _mm_cmpgt_pd(c, zero));
+        __m128d toggle = _mm_andnot_pd(sameSide, _mm_andnot_pd(cZero, crossing));
+
+        if(finishBlock(_mm_movemask_pd(brk), _mm_movemask_pd(toggle), &parity))
+            return parity & 1;
+    }
+    return pointInPolygonScalar(numVertices, vertices, point, i, parity & 1);
+}
+
+static void minDistToLinesSSE2(size_t num, const Vec2 a[], const Vec2 b[], Vec2 point, real_t dists[])
+{
+    const __m128d px = _mm_set1_pd(point.x), py = _mm_set1_pd(point.y);
+    const __m128d eps = _mm_set1_pd(EPSILON), signBit = _mm_set1_pd(-0.0), zero = _mm_setzero_pd(), one = _mm_set1_pd(1.0);
+    size_t i = 0;
+    for(; i + 2 <= num; i += 2)
+    {
+        __m128d a0 = _mm_loadu_pd(&a[i].x), a1 = _mm_loadu_pd(&a[i+1].x);
+        __m128d b0 = _mm_loadu_pd(&b[i].x), b1 = _mm_loadu_pd(&b[i+1].x);
+        __m128d ax = _mm_unpacklo_pd(a0, a1), ay = _mm_unpackhi_pd(a0, a1);
+        __m128d bx = _mm_unpacklo_pd(b0, b1), by = _mm_unpackhi_pd(b0, b1);
+
+        __m128d dx = _mm_sub_pd(bx, ax), dy = _mm_sub_pd(by, ay);
+        __m128d l2 = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+        __m128d t = _mm_div_pd(_mm_add_pd(_mm_mul_pd(_mm_sub_pd(px, ax), dx), _mm_mul_pd(_mm_sub_pd(py, ay), dy)), l2);
+        t = _mm_max_pd(zero, _mm_min_pd(one, t));
+        __m128d ex = _mm_sub_pd(_mm_add_pd(ax, _mm_mul_pd(t, dx)), px), ey = _mm_sub_pd(_mm_add_pd(ay, _mm_mul_pd(t, dy)), py);
+        __m128d dist = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(ex, ex), _mm_mul_pd(ey, ey)));
+
+        // degenerate lines report the squared distance to a, like MinDistToLine
+        __m128d fx = _mm_sub_pd(ax, px), fy = _mm_sub_pd(ay, py);
+        __m128d dist2A = _mm_add_pd(_mm_mul_pd(fx, fx), _mm_mul_pd(fy, fy));
+        __m128d degenerate = _mm_cmple_pd(_mm_andnot_pd(signBit, l2), eps);
+        _mm_storeu_pd(&dists[i], _mm_or_pd(_mm_and_pd(degenerate, dist2A), _mm_andnot_pd(degenerate, dist)));
+    }
+    minDistToLinesGeneric(num - i, a + i, b + i, point, dists + i);
+}
+
+// splits four consecutive Vec2 into x and y vectors in their original order
+__attribute__((target("avx2")))
+static inline void loadVec2x4(const Vec2 *v, __m256d *x, __m256d *y)
+{
+    __m256d lo = _mm256_loadu_pd(&v[0].x), hi = _mm256_loadu_pd(&v[2].x);
+    *x = _mm256_permute4x64_pd(_mm256_unpacklo_pd(lo, hi), 0xD8);
+    *y = _mm256_permute4x64_pd(_mm256_unpackhi_pd(lo, hi), 0xD8);
+}
+
+__attribute__((target("avx2")))
+static bool pointInPolygonAVX2(size_t numVertices, const Vec2 vertices[], Vec2 point)
+{
+    const __m256d px = _mm256_set1_pd(point.x), py = _mm256_set1_pd(point.y);
+    const __m256d eps = _mm256_set1_pd(EPSILON), signBit = _mm256_set1_pd(-0.0), zero = _mm256_setzero_pd();
+    unsigned parity = 0;
+    size_t i = 0;
+    for(; i + 4 < numVertices; i += 4)
+    {
+        __m256d ax, ay, bx, by;
+        loadVec2x4(&vertices[i], &ax, &ay);
+        loadVec2x4(&vertices[i+1], &bx, &by);
+
+        __m256d eqPAx = _mm256_cmp_pd(_mm256_andnot_pd(signBit, _mm256_sub_pd(px, ax)), eps, _CMP_LE_OQ);
+        __m256d eqPAy = _mm256_cmp_pd(_mm256_andnot_pd(signBit, _mm256_sub_pd(py, ay)), eps, _CMP_LE_OQ);
+        __m256d eqPBx = _mm256_cmp_pd(_mm256_andnot_pd(signBit, _mm256_sub_pd(px, bx)), eps, _CMP_LE_OQ);
+        __m256d eqPBy = _mm256_cmp_pd(_mm256_andnot_pd(signBit, _mm256_sub_pd(py, by)), eps, _CMP_LE_OQ);
+        __m256d eqAB = _mm256_cmp_pd(_mm256_andnot_pd(signBit, _mm256_sub_pd(ay, by)), eps, _CMP_LE_OQ);
+
+        __m256d onVertex = _mm256_or_pd(_mm256_and_pd(eqPAx, eqPAy), _mm256_and_pd(eqPBx, eqPBy));
+        __m256d betweenX = _mm256_or_pd(_mm256_and_pd(_mm256_cmp_pd(px, ax, _CMP_GE_OQ), _mm256_cmp_pd(px, bx, _CMP_LE_OQ)),
+                                        _mm256_and_pd(_mm256_cmp_pd(px, ax, _CMP_LE_OQ), _mm256_cmp_pd(px, bx, _CMP_GE_OQ)));
+        __m256d onHorizontal = _mm256_and_pd(_mm256_and_pd(eqAB, eqPAy), betweenX);
+        __m256d inRange = _mm256_or_pd(_mm256_and_pd(_mm256_cmp_pd(py, ay, _CMP_GE_OQ), _mm256_cmp_pd(py, by, _CMP_LE_OQ)),
+                                       _mm256_and_pd(_mm256_cmp_pd(py, ay, _CMP_LE_OQ), _mm256_cmp_pd(py, by, _CMP_GE_OQ)));
+        __m256d skip = _mm256_or_pd(_mm256_and_pd(eqPAy, _mm256_cmp_pd(by, ay, _CMP_GE_OQ)), _mm256_and_pd(eqPBy, _mm256_cmp_pd(ay, by, _CMP_GE_OQ)));
+        __m256d c = _mm256_sub_pd(_mm256_mul_pd(_mm256_sub_pd(ax, px), _mm256_sub_pd(by, py)), _mm256_mul_pd(_mm256_sub_pd(bx, px), _mm256_sub_pd(ay, py)));
+        __m256d crossing = _mm256_andnot_pd(skip, inRange);
+        __m256d cZero = _mm256_cmp_pd(c, zero, _CMP_EQ_OQ);
+
+        __m256d brk = _mm256_or_pd(_mm256_or_pd(onVertex, onHorizontal), _mm256_and_pd(crossing, cZero));
+        __m256d sameSide = _mm256_xor_pd(_mm256_cmp_pd(ay, by, _CMP_LT_OQ), _mm256_cmp_pd(c, zero, _CMP_GT_OQ));
+        __m256d toggle = _mm256_andnot_pd(sameSide, _mm256_andnot_pd(cZero, crossing));
+
+        if(finishBlock(_mm256_movemask_pd(brk), _mm256_movemask_pd(toggle), &parity))
+            return parity & 1;
+    }
+    return pointInPolygonScalar(numVertices, vertices, point, i, parity & 1);
+}
+
+__attribute__((target("avx2")))
+static void minDistToLinesAVX2(size_t num, const Vec2 a[], const Vec2 b[], Vec2 point, real_t dists[])
+{
+    const __m256d px = _mm256_set1_pd(point.x), py = _mm256_set1_pd(point.y);
+    const __m256d eps = _mm256_set1_pd(EPSILON), signBit = _mm256_set1_pd(-0.0), zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+    size_t i = 0;
+    for(; i + 4 <= num; i += 4)
+    {
+        __m256d ax, ay, bx, by;
+        loadVec2x4(&a[i], &ax, &ay);
+        loadVec2x4(&b[i], &bx, &by);
+
+        __m256d dx = _mm256_sub_pd(bx, ax), dy = _mm256_sub_pd(by, ay);
+        __m256d l2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        __m256d t = _mm256_div_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(px, ax), dx), _mm256_mul_pd(_mm256_sub_pd(py, ay), dy)), l2);
+        t = _mm256_max_pd(zero, _mm256_min_pd(one, t));
+        __m256d ex = _mm256_sub_pd(_mm256_add_pd(ax, _mm256_mul_pd(t, dx)), px), ey = _mm256_sub_pd(_mm256_add_pd(ay, _mm256_mul_pd(t, dy)), py);
+        __m256d dist = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(ex, ex), _mm256_mul_pd(ey, ey)));
+
+        __m256d fx = _mm256_sub_pd(ax, px), fy = _mm256_sub_pd(ay, py);
+        __m256d dist2A = _mm256_add_pd(_mm256_mul_pd(fx, fx), _mm256_mul_pd(fy, fy));
+        __m256d degenerate = _mm256_cmp_pd(_mm256_andnot_pd(signBit, l2), eps, _CMP_LE_OQ);
+        _mm256_storeu_pd(&dists[i], _mm256_blendv_pd(dist, dist2A, degenerate));
+    }
+    minDistToLinesSSE2(num - i, a + i, b + i, point, dists + i);
+}
+#endif
+
+static bool (*pointInPolygonImpl)(size_t, const Vec2[], Vec2);
+static void (*minDistToLinesImpl)(size_t, const Vec2[], const Vec2[], Vec2, real_t[]);
+
+static void selectKernels(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        minDistToLinesImpl = minDistToLinesAVX2;
+        pointInPolygonImpl = pointInPolygonAVX2;
+    }
+    else if(__builtin_cpu_supports("sse2"))
+    {
+        minDistToLinesImpl = minDistToLinesSSE2;
+        pointInPolygonImpl = pointInPolygonSSE2;
+    }
+    else
+#endif
+    {
+        minDistToLinesImpl = minDistToLinesGeneric;
+        pointInPolygonImpl = pointInPolygonGeneric;
+    }
+}
+
+bool PointInPolygonVector(size_t numVertices, Vec2 vertices[static numVertices], Vec2 point)
+{
+    if(!pointInPolygonImpl) selectKernels();
+    return pointInPolygonImpl(numVertices, vertices, point);
+}
+
+real_t MinDistToLine(Vec2 a, Vec2 b, Vec2 point)
+{
+    return minDistToLineScalar(a, b, point);
+}
+
+void MinDistToLines(size_t num, const Vec2 a[], const Vec2 b[], Vec2 point, real_t dists[])
+{
+    if(!minDistToLinesImpl) selectKernels();
+    minDistToLinesImpl(num, a, b, point, dists);
+}
+
 int SideOfMapLine(MapLine *line, Vec2 point)
 {
     return SideOfLine(line->a->pos, line->b->pos, point);
@@ -75,7 +296,7 @@ int SideOfLine(Vec2 a, Vec2 b, Vec2 point)
 
 BoundingBox BoundingBoxFromVertices(size_t numVertices, Vec2 vertices[static numVertices])
 {
-    Vec2 min = { .x = DBL_MAX, .y = DBL_MAX }, max = { .x = DBL_MIN, .y = DBL_MIN };
+    Vec2 min = { .x = DBL_MAX, .y = DBL_MAX }, max = { .x = -DBL_MAX, .y = -DBL_MAX };
     for(size_t i = 0; i < numVertices; ++i)
     {
         Vec2 vert = vertices[i];
@@ -87,7 +308,7 @@ BoundingBox BoundingBoxFromVertices(size_t numVertices, Vec2 vertices[static num
 
 BoundingBox BoundingBoxFromMapLines(size_t numLines, MapLine *lines[static numLines])
 {
-    Vec2 min = { .x = DBL_MAX, .y = DBL_MAX }, max = { .x = DBL_MIN, .y = DBL_MIN };
+    Vec2 min = { .x = DBL_MAX, .y = DBL_MAX }, max = { .x = -DBL_MAX, .y = -DBL_MAX };
     for(size_t i = 0; i < numLines; ++i)
     {
         Vec2 vert = lines[i]->a->pos;
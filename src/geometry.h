@@ -53,6 +53,8 @@ bool PointInSector2(MapSector *sector, Vec2 point);
 bool PointInPolygonVector(size_t numVertices, Vec2 vertices[static numVertices], Vec2 point);
 bool PointInPolygon(struct Polygon *polygon, Vec2 point);
 real_t MinDistToLine(Vec2 a, Vec2 b, Vec2 point);
+// distances from point to the lines a[i]-b[i], uses SSE2/AVX2 when the cpu supports it
+void MinDistToLines(size_t num, const Vec2 a[], const Vec2 b[], Vec2 point, real_t dists[]);
 
 bool LineIsCollinear(line_t a, line_t b);
 bool LineIsParallel(line_t a, line_t b);
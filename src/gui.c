@@ -7,7 +7,9 @@
 #include <time.h>
 #include <string.h>
 
+#include <SDL2/SDL_events.h>
 #include <SDL2/SDL_timer.h>
+#include <SDL2/SDL_video.h>
 
 #include "cimgui.h"
 #include "ImGuiFileDialog.h"
@@ -282,6 +284,51 @@ bool DoGui(EdState *state, bool doQuit)
     return doQuit;
 }
 
+#define PROGRESS_INTERVAL_MS 100
+
+static char progressTitle[256] = { 0 };
+static uint64_t progressTime = 0;
+
+bool GuiProgress(const char *task, size_t done, size_t pending)
+{
+    SDL_Window *window = SDL_GL_GetCurrentWindow();
+    if(!window) return true;
+
+    // a short edit is done before it would show up
+    uint64_t now = SDL_GetTicks64();
+    if(progressTime == 0) progressTime = now;
+    if(now - progressTime < PROGRESS_INTERVAL_MS) return true;
+    progressTime = now;
+
+    if(progressTitle[0] == '\0')
+        snprintf(progressTitle, sizeof progressTitle, "%s", SDL_GetWindowTitle(window));
+
+    char title[512] = { 0 };
+    snprintf(title, sizeof title, "%s - %s: %zu done, %zu pending (Esc to cancel)", progressTitle, task, done, pending);
+    SDL_SetWindowTitle(window, title);
+
+    // the quit event stays queued so the main loop still sees it, key presses would be stale by the time the frame runs
+    SDL_PumpEvents();
+    bool cancel = SDL_PeepEvents(NULL, 0, SDL_PEEKEVENT, SDL_QUIT, SDL_QUIT) > 0;
+    SDL_Event events[16];
+    int numEvents;
+    while((numEvents = SDL_PeepEvents(events, 16, SDL_GETEVENT, SDL_KEYDOWN, SDL_KEYDOWN)) > 0)
+    {
+        for(int i = 0; i < numEvents; ++i)
+            cancel |= events[i].key.keysym.sym == SDLK_ESCAPE;
+    }
+    return !cancel;
+}
+
+void GuiProgressEnd(void)
+{
+    SDL_Window *window = SDL_GL_GetCurrentWindow();
+    if(window && progressTitle[0] != '\0')
+        SDL_SetWindowTitle(window, progressTitle);
+    progressTitle[0] = '\0';
+    progressTime = 0;
+}
+
 static void MainMenuBar(bool *doQuit, EdState *state)
 {
     bool allowFileOps = state->network.hosting || !state->network.connected;
@@ -323,6 +370,8 @@ static void MainMenuBar(bool *doQuit, EdState *state)
             if(igMenuItem_Bool("Paste", "Ctrl+V", false, true)) { EditPaste(state); }
             if(igMenuItem_Bool("Cut", "Ctrl+X", false, true)) { EditCut(state); }
             igSeparator();
+            if(igMenuItem_Bool("Rebuild Sectors", "", false, true)) { EditRebuildSectors(state); }
+            igSeparator();
             if(igBeginMenu("Modes", true))
             {
                 if(igMenuItem_Bool("Vertex", "1", state->data.selectionMode == MODE_VERTEX, true)) { ChangeMode(state, MODE_VERTEX); }
@@ -605,14 +654,14 @@ static void HandleShortcuts(EdState *state)
 static void DoNewMap(EdState *state)
 {
     state->data.editVertexBufferSize = 0;
-    state->data.numSelectedElements = 0;
+    SelectionClear(state);
     NewMap(&state->map);
 }
 
 static void DoLoadMap(EdState *state)
 {
     state->data.editVertexBufferSize = 0;
-    state->data.numSelectedElements = 0;
+    SelectionClear(state);
     OpenMapDialog(&state->map);
 }
 
@@ -7,3 +7,9 @@ void SetStyle(enum Theme theme);
 void InitGui(void);
 void FreeGui(void);
 bool DoGui(EdState *state, bool quitRequest);
+
+// for an edit that runs inside a frame, the progress goes to the window title
+// returns false once escape is pressed or the window is asked to close
+bool GuiProgress(const char *task, size_t done, size_t pending);
+// puts the window title back after the last GuiProgress
+void GuiProgressEnd(void);
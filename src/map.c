@@ -2,7 +2,13 @@
 
 #include "edit.h"
 #include "logging.h"
+#include "map/build.h"
+#include "map/grid.h"
+#include "map/hot.h"
+#include "map/index.h"
+#include "map/props.h"
 #include "map/query.h"
+#include "map/tree.h"
 #include "serialization.h"
 
 #include <string.h>
@@ -22,39 +28,6 @@
 
 #define KEY_IS(k) strcasecmp(key, k) == 0
 
-static void FreeVertList(MapVertex *head)
-{
-    while(head)
-    {
-        MapVertex *vertex = head;
-        head = head->next;
-
-        FreeMapVertex(vertex);
-    }
-}
-
-static void FreeLineList(MapLine *head)
-{
-    while(head)
-    {
-        MapLine *line = head;
-        head = head->next;
-
-        FreeMapLine(line);
-    }
-}
-
-static void FreeSectorList(MapSector *head)
-{
-    while(head)
-    {
-        MapSector *sector = head;
-        head = head->next;
-
-        FreeMapSector(sector);
-    }
-}
-
 LineData DefaultLineData(void)
 {
     return (LineData){ .type = LT_NORMAL };
@@ -65,116 +38,83 @@ SectorData DefaultSectorData(void)
     return (SectorData){ .type = ST_NORMAL };
 }
 
+// texture names are interned, so copying and freeing side/sector data is trivial
 LineData CopyLineData(LineData data)
 {
-    LineData copy = data;
-    if(data.front.lowerTex)
-    {
-        copy.front.lowerTex = malloc(strlen(data.front.lowerTex)+1);
-        strcpy(copy.front.lowerTex, data.front.lowerTex);
-    }
-    if(data.front.middleTex)
-    {
-        copy.front.middleTex = malloc(strlen(data.front.middleTex)+1);
-        strcpy(copy.front.middleTex, data.front.middleTex);
-    }
-    if(data.front.upperTex)
-    {
-        copy.front.upperTex = malloc(strlen(data.front.upperTex)+1);
-        strcpy(copy.front.upperTex, data.front.upperTex);
-    }
-    if(data.back.lowerTex)
-    {
-        copy.back.lowerTex = malloc(strlen(data.back.lowerTex)+1);
-        strcpy(copy.back.lowerTex, data.back.lowerTex);
-    }
-    if(data.back.middleTex)
-    {
-        copy.back.middleTex = malloc(strlen(data.back.middleTex)+1);
-        strcpy(copy.back.middleTex, data.back.middleTex);
-    }
-    if(data.back.upperTex)
-    {
-        copy.back.upperTex = malloc(strlen(data.back.upperTex)+1);
-        strcpy(copy.back.upperTex, data.back.upperTex);
-    }
-    return copy;
+    return data;
 }
 
 SectorData CopySectorData(SectorData data)
 {
-    SectorData copy = data;
-    if(data.ceilTex)
-    {
-        copy.ceilTex = malloc(strlen(data.ceilTex)+1);
-        strcpy(copy.ceilTex, data.ceilTex);
-    }
-    if(data.floorTex)
-    {
-        copy.floorTex = malloc(strlen(data.floorTex)+1);
-        strcpy(copy.floorTex, data.floorTex);
-    }
-    return copy;
+    return data;
 }
 
 void FreeLineData(LineData data)
 {
-    free(data.front.lowerTex);
-    free(data.front.middleTex);
-    free(data.front.upperTex);
-    free(data.back.lowerTex);
-    free(data.back.middleTex);
-    free(data.back.upperTex);
+    (void)data;
 }
 
 void FreeSectorData(SectorData data)
 {
-    free(data.ceilTex);
-    free(data.floorTex);
+    (void)data;
 }
 
-void FreeMapVertex(MapVertex *vertex)
+void FreeMapVertex(Map *map, MapVertex *vertex)
 {
-    free(vertex);
+    if(vertex->attachedLines != vertex->inlineLines)
+        BlockFree(&map->elementHeap, vertex->attachedLines);
+    FreeProperties(map, &vertex->props);
 }
 
-void FreeMapLine(MapLine *line)
+void FreeMapLine(Map *map, MapLine *line)
 {
     FreeLineData(line->data);
-    free(line);
+    FreeProperties(map, &line->props);
 }
 
-void FreeMapSector(MapSector *sector)
+void FreeMapSector(Map *map, MapSector *sector)
 {
     FreeSectorData(sector->data);
+    FreeProperties(map, &sector->props);
 
-    free(sector->outerLines);
+    BlockFree(&map->elementHeap, sector->outerLines);
     for(size_t i = 0; i < sector->numInnerLines; ++i)
-        free(sector->innerLines[i]);
-    free(sector->innerLines);
+        BlockFree(&map->elementHeap, sector->innerLines[i]);
+    BlockFree(&map->elementHeap, sector->innerLines);
+    BlockFree(&map->elementHeap, sector->numInnerLinesNum);
 
-    free(sector->edData.vertices);
-    free(sector->edData.indices);
-
-    free(sector);
+    BlockFree(&map->elementHeap, sector->edData.vertices);
+    BlockFree(&map->elementHeap, sector->edData.indices);
+    BlockFree(&map->elementHeap, sector->rings);
 }
 
 void NewMap(Map *map)
 {
-    FreeVertList(map->headVertex);
+    // every element and the data hanging off it lives in the pools and the element heap
     map->headVertex = map->tailVertex = NULL;
     map->numVertices = 0;
     map->vertexIdx = 0;
+    IndexFree(&map->vertexIndex);
+    VertexGridFree(&map->vertexGrid);
+    PoolInit(&map->vertexPool, sizeof(MapVertex));
 
-    FreeLineList(map->headLine);
     map->headLine = map->tailLine = NULL;
     map->numLines = 0;
     map->lineIdx = 0;
+    IndexFree(&map->lineIndex);
+    LineTableFree(&map->lineTable);
+    LineGridFree(&map->lineGrid);
+    PoolInit(&map->linePool, sizeof(MapLine));
 
-    FreeSectorList(map->headSector);
     map->headSector = map->tailSector = NULL;
     map->numSectors = 0;
     map->sectorIdx = 0;
+    IndexFree(&map->sectorIndex);
+    SectorTableFree(&map->sectorTable);
+    SectorTreeFree(&map->sectorTree);
+    PoolInit(&map->sectorPool, sizeof(MapSector));
+    BlockHeapRelease(&map->elementHeap);
+    HotFree(&map->hot);
 
     free(map->file);
     map->file = NULL;
@@ -199,24 +139,15 @@ static char* parseSide(char *line, Side *side)
     line = ParseLineString(line, &tex);
     if(!line) return NULL;
     if(strcmp(tex, "NULL") != 0)
-    {
-        side->lowerTex = malloc(strlen(tex)+1);
-        strcpy(side->lowerTex, tex);
-    }
+        side->lowerTex = InternString(tex);
     line = ParseLineString(line, &tex);
     if(!line) return NULL;
     if(strcmp(tex, "NULL") != 0)
-    {
-        side->middleTex = malloc(strlen(tex)+1);
-        strcpy(side->middleTex, tex);
-    }
+        side->middleTex = InternString(tex);
     line = ParseLineString(line, &tex);
     if(!line) return NULL;
     if(strcmp(tex, "NULL") != 0)
-    {
-        side->upperTex = malloc(strlen(tex)+1);
-        strcpy(side->upperTex, tex);
-    }
+        side->upperTex = InternString(tex);
     return line;
 }
 
@@ -234,6 +165,12 @@ bool LoadMap(Map *map)
     NewMap(map);
 
     map->vertexIdx = map->lineIdx = map->sectorIdx = 0;
+
+    Arena arena = { 0 };
+    struct { BuildVertex *items; size_t count, capacity; } vertices = { 0 };
+    struct { BuildLine *items; size_t count, capacity; } lines = { 0 };
+    struct { BuildSector *items; size_t count, capacity; } sectors = { 0 };
+
     bool inBlock = false;
     enum ParseMode mode = PARSE_PROPS;
     char readline[1024] = { 0 };
@@ -338,10 +275,8 @@ bool LoadMap(Map *map)
                     if(!line) continue;
                     line = ParseLineReal(line, &pos.y);
 
-                    MapVertex *vertex = EditAddVertex(map, pos);;
-                    vertex->idx = idx;
-
-                    if(idx > map->vertexIdx) map->vertexIdx = idx;
+                    BuildVertex vertex = { .idx = idx, .pos = pos };
+                    arena_da_append(&arena, &vertices, vertex);
                 }
                 break;
             case PARSE_LINES:
@@ -363,16 +298,8 @@ bool LoadMap(Map *map)
                     if(!line) continue;
                     line = parseSide(line, &data.back);
 
-                    MapVertex *vA = GetVertex(map, vertexA);
-                    if(!vA) continue;
-                    MapVertex *vB = GetVertex(map, vertexB);
-                    if(!vB) continue;
-                    MapLine *mapLine = EditAddLine(map, vA, vB, data);
-                    mapLine->idx = idx;
-
-                    if(idx > map->lineIdx) map->lineIdx = idx;
-
-                    FreeLineData(data);
+                    BuildLine mapLine = { .idx = idx, .a = vertexA, .b = vertexB, .data = data };
+                    arena_da_append(&arena, &lines, mapLine);
                 }
                 break;
             case PARSE_SECTORS:
@@ -386,15 +313,11 @@ bool LoadMap(Map *map)
                     line = ParseLineIndex(line, &numOuterLines);
                     if(!line) continue;
 
-                    MapLine *outerLines[numOuterLines];
+                    size_t *outerLines = arena_alloc(&arena, numOuterLines * sizeof *outerLines);
                     for(size_t i = 0; i < numOuterLines; ++i)
                     {
-                        size_t lineIdx;
-                        line = ParseLineIndex(line, &lineIdx);
+                        line = ParseLineIndex(line, &outerLines[i]);
                         if(!line) goto nextLine;
-                        MapLine *mapLine = GetLine(map, lineIdx);
-                        if(!mapLine) goto nextLine;
-                        outerLines[i] = mapLine;
                     }
 
                     line = ParseLineInt(line, &data.floorHeight);
@@ -406,25 +329,13 @@ bool LoadMap(Map *map)
                     char *floorTexture;
                     line = ParseLineTexture(line, &floorTexture);
                     if(!line) continue;
-                    if(floorTexture)
-                    {
-                        data.floorTex = malloc(strlen(floorTexture)+1);
-                        strcpy(data.floorTex, floorTexture);
-                    }
+                    data.floorTex = InternString(floorTexture);
                     char *ceilTexture;
                     line = ParseLineTexture(line, &ceilTexture);
-                    if(ceilTexture)
-                    {
-                        data.ceilTex = malloc(strlen(ceilTexture)+1);
-                        strcpy(data.ceilTex, ceilTexture);
-                    }
-
-                    MapSector *sector = EditAddSector(map, numOuterLines, outerLines, 0, (size_t[0]){}, (MapLine**[0]){}, data);
-                    sector->idx = idx;
+                    data.ceilTex = InternString(ceilTexture);
 
-                    if(idx > map->lineIdx) map->lineIdx = idx;
-
-                    FreeSectorData(data);
+                    BuildSector sector = { .idx = idx, .numOuterLines = numOuterLines, .outerLines = outerLines, .data = data };
+                    arena_da_append(&arena, &sectors, sector);
                 }
                 break;
             default:
@@ -437,13 +348,17 @@ nextLine:
     }
 
     fclose(file);
+
+    BuildMap(map, vertices.count, vertices.items, lines.count, lines.items, sectors.count, sectors.items);
+    arena_free(&arena);
+
     map->dirty = false;
     return true;
 }
 
-static char* getTextureName(char *texname)
+static const char* getTextureName(StringId texname)
 {
-    return texname ? texname : "NULL";
+    return texname ? InternedString(texname) : "NULL";
 }
 
 void SaveMap(Map *map)
@@ -497,9 +412,20 @@ void SaveMap(Map *map)
 
 void FreeMap(Map *map)
 {
-    FreeVertList(map->headVertex);
-    FreeLineList(map->headLine);
-    FreeSectorList(map->headSector);
+    IndexFree(&map->vertexIndex);
+    IndexFree(&map->lineIndex);
+    IndexFree(&map->sectorIndex);
+    VertexGridFree(&map->vertexGrid);
+    LineTableFree(&map->lineTable);
+    LineGridFree(&map->lineGrid);
+    SectorTableFree(&map->sectorTable);
+    SectorTreeFree(&map->sectorTree);
+
+    PoolRelease(&map->vertexPool);
+    PoolRelease(&map->linePool);
+    PoolRelease(&map->sectorPool);
+    BlockHeapRelease(&map->elementHeap);
+    HotFree(&map->hot);
 
     free(map->file);
     map->file = NULL;
@@ -3,6 +3,8 @@
 #include <stddef.h>
 #include <stdint.h>
 #include "vecmath.h"
+#include "utils/intern.h"
+#include "utils/pool.h"
 
 #define MAP_VERSION 1
 
@@ -14,18 +16,24 @@ typedef enum PropertyType
     PROPERTY_ENUM,
 } PropertyType;
 
-#define PROPERTY_KEY_MAX_LENGTH 256
-#define PROPERTY_VALUE_MAX_LENGTH 512
-
 typedef struct Property
 {
-    char key[PROPERTY_KEY_MAX_LENGTH], value[PROPERTY_VALUE_MAX_LENGTH];
+    StringId key;
+    PropertyType type;
+    union
+    {
+        const char *string;
+        bool boolean;
+        double number;
+        StringId enumValue;
+    };
 } Property;
 
+// properties sorted by key, items and string values are blocks in the map's element heap
 typedef struct PropertyTable
 {
     Property *items;
-    size_t count, capacity;
+    uint32_t count, capacity;
 } PropertyTable;
 
 typedef enum LineType
@@ -51,28 +59,42 @@ typedef struct BoundingBox
     Vec2 min, max;
 } BoundingBox;
 
+// a closed loop of the sector's vertices inside edData.vertices
+typedef struct SectorRing
+{
+    size_t offset, length;
+    BoundingBox bb;
+} SectorRing;
+
 struct MapLine;
 struct MapSector;
 
+#define VERTEX_INLINE_LINES 4
+
 typedef struct MapVertex
 {
     Vec2 pos;
 
     size_t idx;
 
-    struct MapLine *attachedLines[256];
-    size_t numAttachedLines;
+    // points to inlineLines until the vertex has more than VERTEX_INLINE_LINES lines attached
+    struct MapLine **attachedLines;
+    size_t numAttachedLines, capacityAttachedLines;
+    struct MapLine *inlineLines[VERTEX_INLINE_LINES];
 
     PropertyTable props;
+    bool selected;
 
+    size_t slot;
     struct MapVertex *next, *prev;
+    struct MapVertex *gridNext;
 } MapVertex;
 
 typedef struct Side
 {
-    char *upperTex;
-    char *middleTex;
-    char *lowerTex;
+    StringId upperTex;
+    StringId middleTex;
+    StringId lowerTex;
 } Side;
 
 typedef struct LineData
@@ -91,10 +113,12 @@ typedef struct MapLine
 
     PropertyTable props;
 
-    bool mark, new;
+    bool mark, new, selected;
 
-    size_t idx;
+    size_t idx, slot;
     struct MapLine *next, *prev;
+    struct MapLine *hashNext;
+    uint32_t gridStamp;
 } MapLine;
 
 typedef struct SectorData
@@ -104,8 +128,8 @@ typedef struct SectorData
     int32_t floorHeight;
     int32_t ceilHeight;
 
-    char *floorTex;
-    char *ceilTex;
+    StringId floorTex;
+    StringId ceilTex;
 } SectorData;
 
 typedef struct MapSector
@@ -122,12 +146,96 @@ typedef struct MapSector
     BoundingBox bb;
 
     PropertyTable props;
+    bool selected;
 
-    size_t idx;
+    size_t idx, slot;
     struct MapSector *next, *prev;
     TriangleData edData;
+    // rings[0] is the outer loop, the others are holes
+    SectorRing *rings;
+    size_t numRings;
+
+    uint64_t signature;
+    // outerLines sorted by idx, compared against a query once the signature matches, stored behind outerLines in the same block
+    MapLine **lineSet;
+    struct MapSector *hashNext;
+    uint32_t treeLeaf;
 } MapSector;
 
+// callback for the spatial queries, element is a MapVertex, MapLine or MapSector
+typedef void (*MapVisitFn)(void *element, void *user);
+
+typedef struct MapIndex
+{
+    void **items;
+    size_t capacity;
+} MapIndex;
+
+// dense copies of the data the query and render loops read, an element's slot is its position in these arrays
+typedef struct MapHotData
+{
+    Vec2 *vertexPos;
+    MapVertex **vertices;
+    size_t numVertices, capVertices;
+
+    Vec2 *lineA, *lineB;
+    MapLine **lines;
+    size_t numLines, capLines;
+
+    BoundingBox *sectorBB;
+    MapSector **sectors;
+    size_t numSectors, capSectors;
+} MapHotData;
+
+typedef struct VertexGrid
+{
+    MapVertex **buckets;
+    size_t numBuckets, count;
+} VertexGrid;
+
+typedef struct LineGridCell
+{
+    int64_t cx, cy;
+    struct MapLine **lines;
+    uint32_t count, capacity;
+} LineGridCell;
+
+// sparse grid of the cells each line passes through, cells are never freed once used
+typedef struct LineGrid
+{
+    LineGridCell *cells;
+    size_t numCells, used;
+    // bumped per query so a line filed in several cells is only visited once
+    uint32_t stamp;
+} LineGrid;
+
+typedef struct LineTable
+{
+    MapLine **buckets;
+    size_t numBuckets, count;
+} LineTable;
+
+typedef struct SectorTable
+{
+    MapSector **buckets;
+    size_t numBuckets, count;
+} SectorTable;
+
+// dynamic bounding volume tree over sector boxes, node 0 is unused so a zero treeLeaf means not in the tree
+typedef struct SectorTreeNode
+{
+    BoundingBox bb;
+    uint32_t parent, left, right;
+    MapSector *sector;
+} SectorTreeNode;
+
+typedef struct SectorTree
+{
+    SectorTreeNode *nodes;
+    uint32_t numNodes, capacity;
+    uint32_t root, freeList;
+} SectorTree;
+
 typedef struct Map
 {
     MapVertex *headVertex, *tailVertex;
@@ -146,6 +254,16 @@ typedef struct Map
     float gravity;
 
     size_t vertexIdx, lineIdx, sectorIdx;
+    MapIndex vertexIndex, lineIndex, sectorIndex;
+    Pool vertexPool, linePool, sectorPool;
+    // spilled vertex adjacency, sector outlines and triangulations, released with the map in one go
+    BlockHeap elementHeap;
+    MapHotData hot;
+    VertexGrid vertexGrid;
+    LineGrid lineGrid;
+    LineTable lineTable;
+    SectorTable sectorTable;
+    SectorTree sectorTree;
 } Map;
 
 LineData DefaultLineData(void);
@@ -155,9 +273,9 @@ SectorData CopySectorData(SectorData data);
 void FreeLineData(LineData data);
 void FreeSectorData(SectorData data);
 
-void FreeMapVertex(MapVertex *vertex);
-void FreeMapLine(MapLine *line);
-void FreeMapSector(MapSector *sector);
+void FreeMapVertex(Map *map, MapVertex *vertex);
+void FreeMapLine(Map *map, MapLine *line);
+void FreeMapSector(Map *map, MapSector *sector);
 
 void NewMap(Map *map);
 bool LoadMap(Map *map);
@@ -0,0 +1,180 @@
+#include "build.h"
+
+#include <stdlib.h>
+
+#include "../edit.h"
+#include "create.h"
+#include "index.h"
+#include "logging.h"
+
+// the index tables are dense, indices far beyond the element count are given fresh ones instead
+#define BUILD_IDX_PER_ELEMENT 4
+#define BUILD_IDX_SLACK 1024
+
+typedef struct Remap
+{
+    size_t idx;
+    size_t item; // position in the build array
+    void *element;
+} Remap;
+
+typedef struct RemapTable
+{
+    Remap *items;
+    size_t count;
+    size_t limit; // indices from here on are remapped
+} RemapTable;
+
+static RemapTable newRemapTable(size_t numElements)
+{
+    return (RemapTable){ .items = malloc(numElements * sizeof(Remap)), .limit = BUILD_IDX_PER_ELEMENT * numElements + BUILD_IDX_SLACK };
+}
+
+static int compareRemaps(const void *a, const void *b)
+{
+    const Remap *ra = a, *rb = b;
+    if(ra->idx != rb->idx) return (ra->idx > rb->idx) - (ra->idx < rb->idx);
+    return (ra->item > rb->item) - (ra->item < rb->item);
+}
+
+// sorts the remapped indices for lookups, the first element with an index wins like it does for the others
+static void sortRemaps(RemapTable *table, const char *kind)
+{
+    qsort(table->items, table->count, sizeof *table->items, compareRemaps);
+    size_t count = 0;
+    for(size_t i = 0; i < table->count; ++i)
+    {
+        if(count > 0 && table->items[count - 1].idx == table->items[i].idx)
+        {
+            LogWarning("Duplicate %s index %zu", kind, table->items[i].idx);
+            continue;
+        }
+        table->items[count++] = table->items[i];
+    }
+    table->count = count;
+}
+
+static void* lookup(const MapIndex *index, const RemapTable *table, size_t idx)
+{
+    if(idx < table->limit) return IndexGet(index, idx);
+
+    Remap key = { .idx = idx };
+    size_t lo = 0, hi = table->count;
+    while(lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if(compareRemaps(&table->items[mid], &key) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < table->count && table->items[lo].idx == idx ? table->items[lo].element : NULL;
+}
+
+static MapLine* buildLine(Map *map, const RemapTable *vertexRemap, size_t idx, const BuildLine *bl)
+{
+    MapVertex *a = lookup(&map->vertexIndex, vertexRemap, bl->a);
+    MapVertex *b = lookup(&map->vertexIndex, vertexRemap, bl->b);
+    if(!a || !b)
+    {
+        LogWarning("Skipping invalid line %zu", bl->idx);
+        return NULL;
+    }
+    return CreateLineUnchecked(map, idx, a, b, bl->data);
+}
+
+static MapSector* buildSector(Map *map, const RemapTable *lineRemap, size_t idx, const BuildSector *bs)
+{
+    MapLine **outerLines = malloc(bs->numOuterLines * sizeof *outerLines);
+    for(size_t j = 0; j < bs->numOuterLines; ++j)
+    {
+        outerLines[j] = lookup(&map->lineIndex, lineRemap, bs->outerLines[j]);
+        if(!outerLines[j])
+        {
+            LogWarning("Skipping sector %zu with missing lines", bs->idx);
+            free(outerLines);
+            return NULL;
+        }
+    }
+
+    MapSector *sector = CreateSectorUnchecked(map, idx, bs->numOuterLines, outerLines, bs->data);
+    free(outerLines);
+    return sector;
+}
+
+void BuildMap(Map *map, size_t numVertices, const BuildVertex vertices[], size_t numLines, const BuildLine lines[], size_t numSectors, const BuildSector sectors[])
+{
+    RemapTable vertexRemap = newRemapTable(numVertices);
+    for(size_t i = 0; i < numVertices; ++i)
+    {
+        if(vertices[i].idx >= vertexRemap.limit)
+        {
+            vertexRemap.items[vertexRemap.count++] = (Remap){ .idx = vertices[i].idx, .item = i };
+            continue;
+        }
+        if(IndexGet(&map->vertexIndex, vertices[i].idx))
+        {
+            LogWarning("Duplicate vertex index %zu", vertices[i].idx);
+            continue;
+        }
+        CreateVertexUnchecked(map, vertices[i].idx, vertices[i].pos);
+    }
+    sortRemaps(&vertexRemap, "vertex");
+    for(size_t i = 0; i < vertexRemap.count; ++i)
+        vertexRemap.items[i].element = CreateVertexUnchecked(map, map->vertexIdx, vertices[vertexRemap.items[i].item].pos);
+
+    RemapTable lineRemap = newRemapTable(numLines);
+    for(size_t i = 0; i < numLines; ++i)
+    {
+        const BuildLine *bl = &lines[i];
+        if(bl->idx >= lineRemap.limit)
+        {
+            lineRemap.items[lineRemap.count++] = (Remap){ .idx = bl->idx, .item = i };
+            continue;
+        }
+        if(IndexGet(&map->lineIndex, bl->idx))
+        {
+            LogWarning("Skipping invalid line %zu", bl->idx);
+            continue;
+        }
+        buildLine(map, &vertexRemap, bl->idx, bl);
+    }
+    sortRemaps(&lineRemap, "line");
+    for(size_t i = 0; i < lineRemap.count; ++i)
+        lineRemap.items[i].element = buildLine(map, &vertexRemap, map->lineIdx, &lines[lineRemap.items[i].item]);
+
+    MapSector **built = malloc(numSectors * sizeof *built);
+    size_t numBuilt = 0;
+    RemapTable sectorRemap = newRemapTable(numSectors);
+    for(size_t i = 0; i < numSectors; ++i)
+    {
+        const BuildSector *bs = &sectors[i];
+        if(bs->numOuterLines > 0 && bs->idx >= sectorRemap.limit)
+        {
+            sectorRemap.items[sectorRemap.count++] = (Remap){ .idx = bs->idx, .item = i };
+            continue;
+        }
+        if(bs->numOuterLines == 0 || IndexGet(&map->sectorIndex, bs->idx))
+        {
+            LogWarning("Skipping invalid sector %zu", bs->idx);
+            continue;
+        }
+
+        MapSector *sector = buildSector(map, &lineRemap, bs->idx, bs);
+        if(sector) built[numBuilt++] = sector;
+    }
+    sortRemaps(&sectorRemap, "sector");
+    for(size_t i = 0; i < sectorRemap.count; ++i)
+    {
+        MapSector *sector = buildSector(map, &lineRemap, map->sectorIdx, &sectors[sectorRemap.items[i].item]);
+        if(sector) built[numBuilt++] = sector;
+    }
+
+    for(size_t i = 0; i < numBuilt; ++i)
+        EditTriangulateSector(map, built[i], 0, (size_t[0]){}, (MapLine**[0]){});
+
+    free(sectorRemap.items);
+    free(lineRemap.items);
+    free(vertexRemap.items);
+    free(built);
+}
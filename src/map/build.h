@@ -0,0 +1,28 @@
+#pragma once
+
+#include "../map.h"
+
+// elements refer to each other by their map index, as in a saved map file
+typedef struct BuildVertex
+{
+    size_t idx;
+    Vec2 pos;
+} BuildVertex;
+
+typedef struct BuildLine
+{
+    size_t idx;
+    size_t a, b;
+    LineData data;
+} BuildLine;
+
+typedef struct BuildSector
+{
+    size_t idx;
+    size_t numOuterLines;
+    size_t *outerLines;
+    SectorData data;
+} BuildSector;
+
+// adds already deduplicated elements without the per element duplicate checks, sectors are triangulated after all elements are in place
+void BuildMap(Map *map, size_t numVertices, const BuildVertex vertices[], size_t numLines, const BuildLine lines[], size_t numSectors, const BuildSector sectors[]);
@@ -1,22 +1,62 @@
 #include "create.h"
 #include "map.h"
+#include "grid.h"
+#include "halfedge.h"
+#include "hot.h"
+#include "index.h"
 
 #include <string.h>
 #include <stdlib.h>
 
-CreateResult CreateVertex(Map *map, Vec2 pos)
+static size_t attachLine(Map *map, MapVertex *vertex, MapLine *line)
 {
-    for(MapVertex *vertex = map->headVertex; vertex; vertex = vertex->next)
+    if(vertex->numAttachedLines == vertex->capacityAttachedLines)
     {
-        if(vec2_eqv(vertex->pos, pos))
+        size_t newCapacity = vertex->capacityAttachedLines * 2;
+        if(vertex->attachedLines == vertex->inlineLines)
+        {
+            vertex->attachedLines = BlockAlloc(&map->elementHeap, newCapacity * sizeof *vertex->attachedLines);
+            memcpy(vertex->attachedLines, vertex->inlineLines, sizeof vertex->inlineLines);
+        }
+        else
         {
-            return (CreateResult){ .mapElement = vertex, .created = false };
+            vertex->attachedLines = BlockRealloc(&map->elementHeap, vertex->attachedLines, newCapacity * sizeof *vertex->attachedLines);
         }
+        vertex->capacityAttachedLines = newCapacity;
+    }
+
+    // keep the lines sorted by direction, the ones after the new line move up by one
+    size_t idx = VertexRingInsertPosition(vertex, line);
+    for(size_t i = idx; i < vertex->numAttachedLines; ++i)
+    {
+        MapLine *attLine = vertex->attachedLines[i];
+        attLine->a == vertex ? attLine->aVertIndex++ : attLine->bVertIndex++;
     }
+    memmove(vertex->attachedLines + idx + 1, vertex->attachedLines + idx, (vertex->numAttachedLines - idx) * sizeof *vertex->attachedLines);
+    vertex->attachedLines[idx] = line;
+    vertex->numAttachedLines++;
+    return idx;
+}
 
-    MapVertex *vertex = calloc(1, sizeof *vertex);
+void ResizeSectorOuterLines(Map *map, MapSector *sector, size_t numLines)
+{
+    // the sorted line set shares the block, it is refilled when the sector goes back into the sector table
+    sector->outerLines = BlockRealloc(&map->elementHeap, sector->outerLines, 2 * numLines * sizeof *sector->outerLines);
+    sector->lineSet = sector->outerLines + numLines;
+    sector->numOuterLines = numLines;
+}
+
+MapVertex* CreateVertexUnchecked(Map *map, size_t idx, Vec2 pos)
+{
+    MapVertex *vertex = PoolAlloc(&map->vertexPool);
     vertex->pos = pos;
-    vertex->idx = map->vertexIdx++;
+    vertex->attachedLines = vertex->inlineLines;
+    vertex->capacityAttachedLines = VERTEX_INLINE_LINES;
+    vertex->idx = idx;
+    if(idx >= map->vertexIdx) map->vertexIdx = idx + 1;
+    IndexSet(&map->vertexIndex, vertex->idx, vertex);
+    VertexGridInsert(&map->vertexGrid, vertex);
+    HotAddVertex(&map->hot, vertex);
     vertex->prev = map->tailVertex;
 
     if(map->headVertex == NULL)
@@ -37,34 +77,35 @@ CreateResult CreateVertex(Map *map, Vec2 pos)
 
     map->dirty = true;
 
-    return (CreateResult){ .mapElement = vertex, .created = true };
+    return vertex;
 }
 
-CreateResult CreateLine(Map *map, MapVertex *v0, MapVertex *v1, LineData data)
+CreateResult CreateVertex(Map *map, Vec2 pos)
 {
-    for(MapLine *line = map->headLine; line; line = line->next)
-    {
-        bool ab = line->a == v0 && line->b == v1;
-        bool ba = line->a == v1 && line->b == v0;
-        if(ab || ba)
-        {
-            return (CreateResult){ .mapElement = line, .created = false };
-        }
-    }
+    MapVertex *existing = VertexGridFind(&map->vertexGrid, pos);
+    if(existing)
+        return (CreateResult){ .mapElement = existing, .created = false };
 
-    MapLine *line = calloc(1, sizeof *line);
+    return (CreateResult){ .mapElement = CreateVertexUnchecked(map, map->vertexIdx, pos), .created = true };
+}
+
+MapLine* CreateLineUnchecked(Map *map, size_t idx, MapVertex *v0, MapVertex *v1, LineData data)
+{
+    MapLine *line = PoolAlloc(&map->linePool);
     line->a = v0;
     line->b = v1;
-    line->idx = map->lineIdx++;
+    line->idx = idx;
+    if(idx >= map->lineIdx) map->lineIdx = idx + 1;
+    IndexSet(&map->lineIndex, line->idx, line);
     line->prev = map->tailLine;
     line->data = CopyLineData(data);
 
-    v0->attachedLines[v0->numAttachedLines] = line;
-    line->aVertIndex = v0->numAttachedLines;
-    v0->numAttachedLines++;
-    v1->attachedLines[v1->numAttachedLines] = line;
-    line->bVertIndex = v1->numAttachedLines;
-    v1->numAttachedLines++;
+    line->aVertIndex = attachLine(map, v0, line);
+    line->bVertIndex = attachLine(map, v1, line);
+
+    LineTableInsert(&map->lineTable, line);
+    HotAddLine(&map->hot, line);
+    LineGridInsert(&map->lineGrid, line, v0->pos, v1->pos);
 
     if(map->headLine == NULL)
     {
@@ -84,45 +125,30 @@ CreateResult CreateLine(Map *map, MapVertex *v0, MapVertex *v1, LineData data)
 
     map->dirty = true;
 
-    return (CreateResult){ .mapElement = line, .created = true };
+    return line;
 }
 
-CreateResult CreateSector(Map *map, size_t numLines, MapLine *lines[static numLines], SectorData data)
+CreateResult CreateLine(Map *map, MapVertex *v0, MapVertex *v1, LineData data)
 {
-    for(MapSector *sector = map->headSector; sector; sector = sector->next)
-    {
-        if(sector->numOuterLines != numLines) continue;
-
-        bool allSame = true;
-        for(size_t i = 0; i < numLines; ++i)
-        {
-            bool sharesALine = false;
-            for(size_t j = 0; j < sector->numOuterLines; ++j)
-            {
-                if(lines[i] == sector->outerLines[j])
-                {
-                    sharesALine = true;
-                    break;
-                }
-            }
-            if(!sharesALine)
-            {
-                allSame = false;
-                break;
-            }
-        }
+    MapLine *existing = LineTableFind(&map->lineTable, v0, v1);
+    if(existing)
+        return (CreateResult){ .mapElement = existing, .created = false };
 
-        if(allSame)
-            return (CreateResult){ .mapElement = sector, .created = false };
-    }
+    return (CreateResult){ .mapElement = CreateLineUnchecked(map, map->lineIdx, v0, v1, data), .created = true };
+}
 
-    MapSector *sector = calloc(1, sizeof *sector);
-    sector->numOuterLines = numLines;
-    sector->outerLines = malloc(sector->numOuterLines * sizeof *sector->outerLines);
+MapSector* CreateSectorUnchecked(Map *map, size_t idx, size_t numLines, MapLine *lines[static numLines], SectorData data)
+{
+    MapSector *sector = PoolAlloc(&map->sectorPool);
+    ResizeSectorOuterLines(map, sector, numLines);
     memcpy(sector->outerLines, lines, sector->numOuterLines * sizeof *sector->outerLines);
-    sector->idx = map->sectorIdx++;
+    sector->idx = idx;
+    if(idx >= map->sectorIdx) map->sectorIdx = idx + 1;
+    IndexSet(&map->sectorIndex, sector->idx, sector);
     sector->prev = map->tailSector;
     sector->data = CopySectorData(data);
+    SectorTableInsert(&map->sectorTable, sector);
+    HotAddSector(&map->hot, sector);
 
     if(map->headSector == NULL)
     {
@@ -143,5 +169,14 @@ CreateResult CreateSector(Map *map, size_t numLines, MapLine *lines[static numLi
 
     map->dirty = true;
 
-    return (CreateResult){ .mapElement = sector, .created = true };
+    return sector;
+}
+
+CreateResult CreateSector(Map *map, size_t numLines, MapLine *lines[static numLines], SectorData data)
+{
+    MapSector *existing = SectorTableFind(&map->sectorTable, numLines, lines);
+    if(existing)
+        return (CreateResult){ .mapElement = existing, .created = false };
+
+    return (CreateResult){ .mapElement = CreateSectorUnchecked(map, map->sectorIdx, numLines, lines, data), .created = true };
 }
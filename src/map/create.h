@@ -10,6 +10,14 @@ typedef struct CreateResult
     bool created;
 } CreateResult;
 
+// the unchecked variants skip the duplicate lookup and place the element at the given index
+MapVertex* CreateVertexUnchecked(Map *map, size_t idx, Vec2 pos);
+MapLine* CreateLineUnchecked(Map *map, size_t idx, MapVertex *v0, MapVertex *v1, LineData data);
+MapSector* CreateSectorUnchecked(Map *map, size_t idx, size_t numLines, MapLine *lines[static numLines], SectorData data);
+
+// keeps the first lines of the outline, the sector must be out of the sector table while it changes
+void ResizeSectorOuterLines(Map *map, MapSector *sector, size_t numLines);
+
 CreateResult CreateVertex(Map *map, Vec2 pos);
 CreateResult CreateLine(Map *map, MapVertex *v0, MapVertex *v1, LineData data);
 CreateResult CreateSector(Map *map, size_t numLines, MapLine *lines[static numLines], SectorData data);
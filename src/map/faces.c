@@ -0,0 +1,466 @@
+#include "faces.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#include "../edit.h"
+#include "halfedge.h"
+#include "logging.h"
+#include "query.h"
+#include "remove.h"
+
+#define NO_FACE SIZE_MAX
+#define NO_NODE SIZE_MAX
+
+typedef struct Face
+{
+    HalfEdge start;
+    // the walk around the face without its dangling lines, empty for the outside of a tree of lines
+    HalfEdge *edges;
+    size_t numEdges;
+    // walked counter-clockwise around the area it encloses, the outside of a group of lines is walked the other way
+    bool bounded;
+
+    // for the outside of a group of lines, its leftmost vertex and the bounded face the group lies in
+    // the holes of a bounded face are linked through nextHole
+    MapVertex *leftmost;
+    size_t container;
+    size_t firstHole, nextHole;
+
+    // a sector that was on this face before the rebuild and the one it ends up with
+    MapSector *previous, *sector;
+} Face;
+
+typedef struct Faces
+{
+    Face *items;
+    size_t count, capacity;
+} Faces;
+
+// the outside of a group of lines, sorted left to right by its leftmost vertex
+typedef struct Outside
+{
+    MapVertex *leftmost;
+    size_t face;
+} Outside;
+
+// the lines crossing a horizontal sweep line, a treap ordered by where they cross it
+typedef struct ActiveLine
+{
+    MapLine *line;
+    uint64_t priority;
+    size_t parent, child[2];
+} ActiveLine;
+
+typedef struct ActiveLines
+{
+    ActiveLine *nodes;
+    size_t root;
+} ActiveLines;
+
+// at the same y lines leave the sweep before others enter, the rays are shot once both are done
+typedef enum RayEventKind
+{
+    RAY_LEAVE,
+    RAY_ENTER,
+    RAY_SHOOT,
+} RayEventKind;
+
+typedef struct RayEvent
+{
+    real_t y;
+    RayEventKind kind;
+    size_t item;
+} RayEvent;
+
+// reset on every rebuild, so the memory is reused by the next one
+static Arena rebuildArena = { 0 };
+
+static inline size_t halfEdgeSlot(HalfEdge edge)
+{
+    return edge.line->slot * 2 + edge.back;
+}
+
+static inline MapSector** sideSector(HalfEdge edge)
+{
+    return edge.back ? &edge.line->backSector : &edge.line->frontSector;
+}
+
+static inline bool leftOf(const MapVertex *a, const MapVertex *b)
+{
+    return a->pos.x < b->pos.x || (a->pos.x == b->pos.x && a->pos.y < b->pos.y);
+}
+
+static int compareLeftmost(const void *a, const void *b)
+{
+    const Outside *oa = a, *ob = b;
+    return leftOf(oa->leftmost, ob->leftmost) ? -1 : leftOf(ob->leftmost, oa->leftmost);
+}
+
+static int compareRayEvents(const void *a, const void *b)
+{
+    const RayEvent *ea = a, *eb = b;
+    if(ea->y != eb->y) return ea->y < eb->y ? -1 : 1;
+    if(ea->kind != eb->kind) return ea->kind < eb->kind ? -1 : 1;
+    return (ea->item > eb->item) - (ea->item < eb->item);
+}
+
+static inline real_t crossingX(const MapLine *line, real_t y)
+{
+    Vec2 a = line->a->pos, b = line->b->pos;
+    if(y == a.y) return a.x;
+    if(y == b.y) return b.x;
+    return a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y);
+}
+
+static inline real_t inverseSlope(const MapLine *line)
+{
+    return (line->b->pos.x - line->a->pos.x) / (line->b->pos.y - line->a->pos.y);
+}
+
+// left to right just above y, lines only meet at vertices so the order holds while both cross the sweep
+static bool crossesBefore(const MapLine *l0, const MapLine *l1, real_t y)
+{
+    const real_t x0 = crossingX(l0, y), x1 = crossingX(l1, y);
+    if(x0 != x1) return x0 < x1;
+    const real_t s0 = inverseSlope(l0), s1 = inverseSlope(l1);
+    if(s0 != s1) return s0 < s1;
+    return l0 < l1;
+}
+
+static void rotateUp(ActiveLines *set, size_t n)
+{
+    ActiveLine *nodes = set->nodes;
+    const size_t p = nodes[n].parent, g = nodes[p].parent;
+    const int dir = nodes[p].child[1] == n;
+    const size_t inner = nodes[n].child[!dir];
+
+    nodes[p].child[dir] = inner;
+    if(inner != NO_NODE) nodes[inner].parent = p;
+    nodes[n].child[!dir] = p;
+    nodes[p].parent = n;
+    nodes[n].parent = g;
+    if(g == NO_NODE)
+        set->root = n;
+    else
+        nodes[g].child[nodes[g].child[1] == p] = n;
+}
+
+static void activateLine(ActiveLines *set, size_t n, real_t y)
+{
+    ActiveLine *nodes = set->nodes;
+    nodes[n].child[0] = nodes[n].child[1] = NO_NODE;
+    nodes[n].parent = NO_NODE;
+    if(set->root == NO_NODE)
+    {
+        set->root = n;
+        return;
+    }
+
+    for(size_t cur = set->root; ; )
+    {
+        const int dir = !crossesBefore(nodes[n].line, nodes[cur].line, y);
+        if(nodes[cur].child[dir] == NO_NODE)
+        {
+            nodes[cur].child[dir] = n;
+            nodes[n].parent = cur;
+            break;
+        }
+        cur = nodes[cur].child[dir];
+    }
+    while(nodes[n].parent != NO_NODE && nodes[nodes[n].parent].priority < nodes[n].priority)
+        rotateUp(set, n);
+}
+
+// the node is removed by its position in the tree, no comparison is needed on the way out
+static void deactivateLine(ActiveLines *set, size_t n)
+{
+    ActiveLine *nodes = set->nodes;
+    while(nodes[n].child[0] != NO_NODE || nodes[n].child[1] != NO_NODE)
+    {
+        const size_t c0 = nodes[n].child[0], c1 = nodes[n].child[1];
+        rotateUp(set, c1 == NO_NODE || (c0 != NO_NODE && nodes[c0].priority > nodes[c1].priority) ? c0 : c1);
+    }
+
+    const size_t p = nodes[n].parent;
+    if(p == NO_NODE)
+        set->root = NO_NODE;
+    else
+        nodes[p].child[nodes[p].child[1] == n] = NO_NODE;
+}
+
+// the rightmost line crossing just above origin left of it, the half open y ranges count a line through a vertex once
+static MapLine* firstLineLeft(const ActiveLines *set, Vec2 origin)
+{
+    MapLine *hit = NULL;
+    for(size_t cur = set->root; cur != NO_NODE; )
+    {
+        const bool left = crossingX(set->nodes[cur].line, origin.y) < origin.x;
+        if(left) hit = set->nodes[cur].line;
+        cur = set->nodes[cur].child[left];
+    }
+    return hit;
+}
+
+static inline uint64_t mixBits(uint64_t v)
+{
+    v ^= v >> 33;
+    v *= 0xff51afd7ed558ccdull;
+    v ^= v >> 33;
+    v *= 0xc4ceb9fe1a85ec53ull;
+    v ^= v >> 33;
+    return v;
+}
+
+// shoots a ray left from every outside's leftmost vertex in one sweep from bottom to top
+static MapLine** shootLeft(Map *map, size_t numOutsides, const Outside outsides[static numOutsides])
+{
+    MapLine **hits = arena_alloc(&rebuildArena, (numOutsides + 1) * sizeof *hits);
+    ActiveLines set = { .nodes = arena_alloc(&rebuildArena, (map->numLines + 1) * sizeof *set.nodes), .root = NO_NODE };
+    RayEvent *events = arena_alloc(&rebuildArena, (2 * map->numLines + numOutsides + 1) * sizeof *events);
+    size_t numEvents = 0, numNodes = 0;
+
+    for(MapLine *line = map->headLine; line; line = line->next)
+    {
+        // a horizontal line is never crossed by a horizontal ray
+        Vec2 a = line->a->pos, b = line->b->pos;
+        if(a.y == b.y) continue;
+
+        set.nodes[numNodes] = (ActiveLine){ .line = line, .priority = mixBits(numNodes + 1) };
+        events[numEvents++] = (RayEvent){ .y = a.y < b.y ? a.y : b.y, .kind = RAY_ENTER, .item = numNodes };
+        events[numEvents++] = (RayEvent){ .y = a.y < b.y ? b.y : a.y, .kind = RAY_LEAVE, .item = numNodes };
+        numNodes++;
+    }
+    for(size_t i = 0; i < numOutsides; ++i)
+        events[numEvents++] = (RayEvent){ .y = outsides[i].leftmost->pos.y, .kind = RAY_SHOOT, .item = i };
+    qsort(events, numEvents, sizeof *events, compareRayEvents);
+
+    for(size_t e = 0; e < numEvents; ++e)
+    {
+        const RayEvent *event = &events[e];
+        switch(event->kind)
+        {
+        case RAY_LEAVE:
+            deactivateLine(&set, event->item);
+            break;
+        case RAY_ENTER:
+            activateLine(&set, event->item, event->y);
+            break;
+        case RAY_SHOOT:
+            hits[event->item] = firstLineLeft(&set, outsides[event->item].leftmost->pos);
+            break;
+        }
+    }
+    return hits;
+}
+
+static bool sameSector(MapSector *sector, const Faces *faces, const Face *face)
+{
+    for(size_t i = 0; i < face->numEdges; ++i)
+        if(*sideSector(face->edges[i]) != sector) return false;
+
+    size_t numHoles = 0;
+    for(size_t h = face->firstHole; h != NO_FACE; h = faces->items[h].nextHole)
+    {
+        const Face *hole = &faces->items[h];
+        for(size_t i = 0; i < hole->numEdges; ++i)
+            if(*sideSector(hole->edges[i]) != sector) return false;
+        numHoles++;
+    }
+    return numHoles + 1 == sector->numRings;
+}
+
+static int compareSectors(const void *a, const void *b)
+{
+    const MapSector *sa = *(MapSector * const *)a, *sb = *(MapSector * const *)b;
+    return (sa > sb) - (sa < sb);
+}
+
+// a sector's loop starts with a line walked from a to b, a face starting the other way is listed backwards
+static MapLine** boundaryLines(const Face *face)
+{
+    const size_t n = face->numEdges;
+    MapLine **lines = arena_alloc(&rebuildArena, n * sizeof *lines);
+    for(size_t i = 0; i < n; ++i)
+        lines[i] = face->edges[face->edges[0].back ? (n - i) % n : i].line;
+    return lines;
+}
+
+void RebuildMapSectors(Map *map)
+{
+    arena_reset(&rebuildArena);
+    Faces faces = { 0 };
+
+    const size_t numHalfEdges = map->numLines * 2;
+    size_t *faceOf = arena_alloc(&rebuildArena, (numHalfEdges + 1) * sizeof *faceOf);
+    bool *onBoundary = arena_alloc(&rebuildArena, numHalfEdges + 1);
+    for(size_t i = 0; i < numHalfEdges; ++i)
+    {
+        faceOf[i] = NO_FACE;
+        onBoundary[i] = false;
+    }
+
+    MapSector **live = arena_alloc(&rebuildArena, (map->numSectors + 1) * sizeof *live);
+    size_t numLive = 0;
+    for(MapSector *sector = map->headSector; sector; sector = sector->next)
+        live[numLive++] = sector;
+    if(numLive > 1)
+        qsort(live, numLive, sizeof *live, compareSectors);
+
+    // every half-edge belongs to exactly one face, walking each face once labels them all
+    for(MapLine *line = map->headLine; line; line = line->next)
+    {
+        for(int back = 0; back < 2; ++back)
+        {
+            HalfEdge start = { .line = line, .back = back };
+            if(faceOf[halfEdgeSlot(start)] != NO_FACE) continue;
+
+            Face face = { .start = start, .container = NO_FACE, .firstHole = NO_FACE, .nextHole = NO_FACE };
+            HalfEdge edge = start;
+            do
+            {
+                faceOf[halfEdgeSlot(edge)] = faces.count;
+                MapVertex *origin = HalfEdgeOrigin(edge);
+                if(!face.leftmost || leftOf(origin, face.leftmost))
+                    face.leftmost = origin;
+                // only a live sector can hand down its data, the pointer is looked up rather than followed
+                MapSector *side = *sideSector(edge);
+                if(!face.previous && side && bsearch(&side, live, numLive, sizeof *live, compareSectors))
+                    face.previous = side;
+                edge = HalfEdgeNext(edge);
+            } while(!HalfEdgeEq(edge, start));
+
+            arena_da_append(&rebuildArena, &faces, face);
+        }
+    }
+
+    Outside *outsides = arena_alloc(&rebuildArena, (faces.count + 1) * sizeof *outsides);
+    size_t numOutsides = 0;
+    for(size_t f = 0; f < faces.count; ++f)
+    {
+        Face *face = &faces.items[f];
+        size_t numEdges = 0;
+        HalfEdge *edges = FaceBoundary(face->start, &numEdges);
+        face->edges = arena_alloc(&rebuildArena, (numEdges + 1) * sizeof *face->edges);
+        memcpy(face->edges, edges, numEdges * sizeof *edges);
+        face->numEdges = numEdges;
+
+        real_t area = 0;
+        for(size_t i = 0; i < numEdges; ++i)
+        {
+            Vec2 a = HalfEdgeOrigin(edges[i])->pos, b = HalfEdgeTarget(edges[i])->pos;
+            area += a.x * b.y - b.x * a.y;
+        }
+        face->bounded = numEdges >= 3 && area > 0;
+        if(!face->bounded)
+            outsides[numOutsides++] = (Outside){ .leftmost = face->leftmost, .face = f };
+    }
+
+    // a group of lines lies in the face right of its leftmost vertex, going left to right the face found
+    // on the other side of a group that is also just an outside was already resolved
+    if(numOutsides > 1)
+        qsort(outsides, numOutsides, sizeof *outsides, compareLeftmost);
+    MapLine **hits = shootLeft(map, numOutsides, outsides);
+    for(size_t i = 0; i < numOutsides; ++i)
+    {
+        Face *face = &faces.items[outsides[i].face];
+        MapLine *hit = hits[i];
+        if(!hit) continue;
+
+        // the half-edge running down has the face right of the line
+        HalfEdge edge = { .line = hit, .back = hit->a->pos.y < hit->b->pos.y };
+        const Face *hitFace = &faces.items[faceOf[halfEdgeSlot(edge)]];
+        face->container = hitFace->bounded ? faceOf[halfEdgeSlot(edge)] : hitFace->container;
+        if(face->container == NO_FACE || face->numEdges == 0) continue;
+
+        face->nextHole = faces.items[face->container].firstHole;
+        faces.items[face->container].firstHole = outsides[i].face;
+    }
+
+    // keep the sectors that still match their face, everything else is rebuilt
+    MapSector **kept = arena_alloc(&rebuildArena, (map->numSectors + 1) * sizeof *kept);
+    size_t numKept = 0;
+    for(size_t f = 0; f < faces.count; ++f)
+    {
+        Face *face = &faces.items[f];
+        if(!face->bounded) continue;
+        MapSector *existing = FindEquivalentSector(map, face->numEdges, boundaryLines(face));
+        if(existing && sameSector(existing, &faces, face))
+        {
+            face->sector = existing;
+            kept[numKept++] = existing;
+        }
+        else if(existing)
+        {
+            face->previous = existing;
+        }
+    }
+    if(numKept > 1)
+        qsort(kept, numKept, sizeof *kept, compareSectors);
+
+    // the data of the sectors that go away is needed for the faces that take it over
+    SectorData *data = arena_alloc(&rebuildArena, (faces.count + 1) * sizeof *data);
+    for(size_t f = 0; f < faces.count; ++f)
+    {
+        const Face *face = &faces.items[f];
+        if(face->bounded && !face->sector)
+            data[f] = face->previous ? CopySectorData(face->previous->data) : DefaultSectorData();
+    }
+
+    size_t numRemoved = 0;
+    for(MapSector *sector = map->headSector, *next; sector; sector = next)
+    {
+        next = sector->next;
+        if(bsearch(&sector, kept, numKept, sizeof *kept, compareSectors)) continue;
+        RemoveSector(map, sector);
+        numRemoved++;
+    }
+
+    size_t numCreated = 0;
+    for(size_t f = 0; f < faces.count; ++f)
+    {
+        Face *face = &faces.items[f];
+        if(!face->bounded || face->sector) continue;
+
+        size_t numHoles = 0;
+        for(size_t h = face->firstHole; h != NO_FACE; h = faces.items[h].nextHole)
+            numHoles++;
+        MapLine ***holeLines = arena_alloc(&rebuildArena, (numHoles + 1) * sizeof *holeLines);
+        size_t *holeLinesNum = arena_alloc(&rebuildArena, (numHoles + 1) * sizeof *holeLinesNum);
+        size_t numHoleLoops = 0;
+        for(size_t h = face->firstHole; h != NO_FACE; h = faces.items[h].nextHole)
+        {
+            holeLinesNum[numHoleLoops] = faces.items[h].numEdges;
+            holeLines[numHoleLoops++] = boundaryLines(&faces.items[h]);
+        }
+
+        face->sector = EditAddSector(map, face->numEdges, boundaryLines(face), numHoleLoops, holeLinesNum, holeLines, data[f]);
+        FreeSectorData(data[f]);
+        numCreated++;
+    }
+
+    // point every line at the sectors now on its sides, this also drops the ones left from removed sectors
+    for(size_t f = 0; f < faces.count; ++f)
+    {
+        const Face *face = &faces.items[f];
+        const Face *owner = face->bounded ? face : face->container != NO_FACE ? &faces.items[face->container] : NULL;
+        for(size_t i = 0; i < face->numEdges; ++i)
+            onBoundary[halfEdgeSlot(face->edges[i])] = owner != NULL;
+    }
+    for(MapLine *line = map->headLine; line; line = line->next)
+    {
+        for(int back = 0; back < 2; ++back)
+        {
+            HalfEdge edge = { .line = line, .back = back };
+            const size_t slot = halfEdgeSlot(edge);
+            const Face *face = &faces.items[faceOf[slot]];
+            const Face *owner = face->bounded ? face : face->container != NO_FACE ? &faces.items[face->container] : NULL;
+            *sideSector(edge) = onBoundary[slot] ? owner->sector : NULL;
+        }
+    }
+
+    LogDebug("Rebuilt sectors: %zu faces, %zu kept, %zu removed, %zu created", faces.count, numKept, numRemoved, numCreated);
+    arena_reset(&rebuildArena);
+}
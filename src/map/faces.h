@@ -0,0 +1,7 @@
+#pragma once
+
+#include "../map.h"
+
+// rebuilds every sector from the faces of the line graph in one pass, holes go to the face they lie in
+// a sector that still matches its face is kept, the others take the data of a sector that was on the same side
+void RebuildMapSectors(Map *map);
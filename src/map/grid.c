@@ -0,0 +1,417 @@
+#include "grid.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "../geometry.h"
+
+#define VERTEX_GRID_MIN_BUCKETS 1024
+#define LINE_GRID_MIN_CELLS 1024
+#define LINE_CELL_MIN_CAPACITY 4
+
+static inline int64_t cellCoord(real_t v)
+{
+    return (int64_t)floor(v / VERTEX_GRID_CELL_SIZE);
+}
+
+static inline size_t cellBucket(size_t numBuckets, int64_t cx, int64_t cy)
+{
+    uint64_t h = (uint64_t)cx * 0x9E3779B97F4A7C15ull ^ (uint64_t)cy * 0xC2B2AE3D27D4EB4Full;
+    h ^= h >> 32;
+    return h & (numBuckets - 1);
+}
+
+static inline size_t vertexBucket(size_t numBuckets, Vec2 pos)
+{
+    return cellBucket(numBuckets, cellCoord(pos.x), cellCoord(pos.y));
+}
+
+static void rehash(VertexGrid *grid, size_t numBuckets)
+{
+    MapVertex **buckets = calloc(numBuckets, sizeof *buckets);
+    for(size_t i = 0; i < grid->numBuckets; ++i)
+    {
+        MapVertex *vertex = grid->buckets[i];
+        while(vertex)
+        {
+            MapVertex *next = vertex->gridNext;
+            size_t b = vertexBucket(numBuckets, vertex->pos);
+            vertex->gridNext = buckets[b];
+            buckets[b] = vertex;
+            vertex = next;
+        }
+    }
+    free(grid->buckets);
+    grid->buckets = buckets;
+    grid->numBuckets = numBuckets;
+}
+
+void VertexGridInsert(VertexGrid *grid, MapVertex *vertex)
+{
+    if(grid->count >= grid->numBuckets)
+        rehash(grid, grid->numBuckets == 0 ? VERTEX_GRID_MIN_BUCKETS : grid->numBuckets * 2);
+
+    size_t b = vertexBucket(grid->numBuckets, vertex->pos);
+    vertex->gridNext = grid->buckets[b];
+    grid->buckets[b] = vertex;
+    grid->count++;
+}
+
+void VertexGridRemove(VertexGrid *grid, MapVertex *vertex)
+{
+    if(grid->numBuckets == 0) return;
+
+    MapVertex **link = &grid->buckets[vertexBucket(grid->numBuckets, vertex->pos)];
+    while(*link && *link != vertex)
+        link = &(*link)->gridNext;
+
+    if(*link)
+    {
+        *link = vertex->gridNext;
+        vertex->gridNext = NULL;
+        grid->count--;
+    }
+}
+
+MapVertex* VertexGridFind(const VertexGrid *grid, Vec2 pos)
+{
+    if(grid->numBuckets == 0) return NULL;
+
+    // a vertex within EPSILON can sit in a neighbouring cell when pos is right on a cell border
+    int64_t minX = cellCoord(pos.x - EPSILON), maxX = cellCoord(pos.x + EPSILON);
+    int64_t minY = cellCoord(pos.y - EPSILON), maxY = cellCoord(pos.y + EPSILON);
+    for(int64_t cy = minY; cy <= maxY; ++cy)
+    {
+        for(int64_t cx = minX; cx <= maxX; ++cx)
+        {
+            for(MapVertex *vertex = grid->buckets[cellBucket(grid->numBuckets, cx, cy)]; vertex; vertex = vertex->gridNext)
+            {
+                if(vec2_eqv(vertex->pos, pos))
+                    return vertex;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void closestInBucket(const MapVertex *vertex, Vec2 pos, float radiusSq, MapVertex **closest, float *closestDist)
+{
+    for(; vertex; vertex = vertex->gridNext)
+    {
+        float distSq = vec2_distance2(vertex->pos, pos);
+        if(distSq > radiusSq) continue;
+        // ties go to the lowest slot, which is what a linear scan over the hot arrays picks
+        if(distSq < *closestDist || (distSq == *closestDist && vertex->slot < (*closest)->slot))
+        {
+            *closestDist = distSq;
+            *closest = (MapVertex*)vertex;
+        }
+    }
+}
+
+MapVertex* VertexGridFindClosest(const VertexGrid *grid, const MapHotData *hot, Vec2 pos, float radiusSq)
+{
+    MapVertex *closest = NULL;
+    float closestDist = FLT_MAX;
+    if(grid->numBuckets == 0) return NULL;
+
+    real_t radius = sqrt(radiusSq);
+    int64_t minX = cellCoord(pos.x - radius), maxX = cellCoord(pos.x + radius);
+    int64_t minY = cellCoord(pos.y - radius), maxY = cellCoord(pos.y + radius);
+    if((uint64_t)(maxX - minX + 1) * (uint64_t)(maxY - minY + 1) > grid->count)
+    {
+        for(size_t i = 0; i < hot->numVertices; ++i)
+        {
+            float distSq = vec2_distance2(hot->vertexPos[i], pos);
+            if(distSq <= radiusSq && distSq < closestDist)
+            {
+                closestDist = distSq;
+                closest = hot->vertices[i];
+            }
+        }
+        return closest;
+    }
+
+    for(int64_t cy = minY; cy <= maxY; ++cy)
+    {
+        for(int64_t cx = minX; cx <= maxX; ++cx)
+            closestInBucket(grid->buckets[cellBucket(grid->numBuckets, cx, cy)], pos, radiusSq, &closest, &closestDist);
+    }
+    return closest;
+}
+
+static inline bool boxContains(BoundingBox box, Vec2 p)
+{
+    return p.x >= box.min.x && p.y >= box.min.y && p.x <= box.max.x && p.y <= box.max.y;
+}
+
+void VertexGridQueryBox(const VertexGrid *grid, const MapHotData *hot, BoundingBox box, MapVisitFn fn, void *user)
+{
+    if(grid->numBuckets == 0) return;
+
+    int64_t minX = cellCoord(box.min.x), maxX = cellCoord(box.max.x);
+    int64_t minY = cellCoord(box.min.y), maxY = cellCoord(box.max.y);
+    if((uint64_t)(maxX - minX + 1) * (uint64_t)(maxY - minY + 1) > grid->count)
+    {
+        for(size_t i = 0; i < hot->numVertices; ++i)
+        {
+            if(boxContains(box, hot->vertexPos[i]))
+                fn(hot->vertices[i], user);
+        }
+        return;
+    }
+
+    for(int64_t cy = minY; cy <= maxY; ++cy)
+    {
+        for(int64_t cx = minX; cx <= maxX; ++cx)
+        {
+            for(MapVertex *vertex = grid->buckets[cellBucket(grid->numBuckets, cx, cy)]; vertex; vertex = vertex->gridNext)
+            {
+                // buckets are shared between cells, only take the vertices of this cell so none is visited twice
+                if(cellCoord(vertex->pos.x) != cx || cellCoord(vertex->pos.y) != cy)
+                    continue;
+                if(boxContains(box, vertex->pos))
+                    fn(vertex, user);
+            }
+        }
+    }
+}
+
+void VertexGridFree(VertexGrid *grid)
+{
+    free(grid->buckets);
+    *grid = (VertexGrid){ 0 };
+}
+
+static inline int64_t lineCellCoord(real_t v)
+{
+    return (int64_t)floor(v / LINE_GRID_CELL_SIZE);
+}
+
+static LineGridCell* findCell(const LineGrid *grid, int64_t cx, int64_t cy)
+{
+    if(grid->numCells == 0) return NULL;
+
+    size_t c = cellBucket(grid->numCells, cx, cy);
+    while(grid->cells[c].lines)
+    {
+        if(grid->cells[c].cx == cx && grid->cells[c].cy == cy)
+            return &grid->cells[c];
+        c = (c + 1) & (grid->numCells - 1);
+    }
+    return NULL;
+}
+
+static LineGridCell* insertCell(LineGrid *grid, LineGridCell cell)
+{
+    size_t c = cellBucket(grid->numCells, cell.cx, cell.cy);
+    while(grid->cells[c].lines)
+        c = (c + 1) & (grid->numCells - 1);
+    grid->cells[c] = cell;
+    return &grid->cells[c];
+}
+
+static LineGridCell* getCell(LineGrid *grid, int64_t cx, int64_t cy)
+{
+    LineGridCell *cell = findCell(grid, cx, cy);
+    if(cell) return cell;
+
+    // keep the table at most half full, a used cell always has its lines array allocated
+    if((grid->used + 1) * 2 > grid->numCells)
+    {
+        LineGridCell *old = grid->cells;
+        size_t oldNum = grid->numCells;
+        grid->numCells = oldNum == 0 ? LINE_GRID_MIN_CELLS : oldNum * 2;
+        grid->cells = calloc(grid->numCells, sizeof *grid->cells);
+        for(size_t i = 0; i < oldNum; ++i)
+        {
+            if(old[i].lines)
+                insertCell(grid, old[i]);
+        }
+        free(old);
+    }
+
+    grid->used++;
+    return insertCell(grid, (LineGridCell){
+        .cx = cx,
+        .cy = cy,
+        .lines = malloc(LINE_CELL_MIN_CAPACITY * sizeof(MapLine*)),
+        .capacity = LINE_CELL_MIN_CAPACITY
+    });
+}
+
+static void addToCell(LineGrid *grid, int64_t cx, int64_t cy, MapLine *line)
+{
+    LineGridCell *cell = getCell(grid, cx, cy);
+    if(cell->count == cell->capacity)
+    {
+        cell->capacity *= 2;
+        cell->lines = realloc(cell->lines, cell->capacity * sizeof *cell->lines);
+    }
+    cell->lines[cell->count++] = line;
+}
+
+static void removeFromCell(LineGrid *grid, int64_t cx, int64_t cy, MapLine *line)
+{
+    LineGridCell *cell = findCell(grid, cx, cy);
+    if(!cell) return;
+
+    for(uint32_t i = 0; i < cell->count; ++i)
+    {
+        if(cell->lines[i] == line)
+        {
+            cell->lines[i] = cell->lines[--cell->count];
+            return;
+        }
+    }
+}
+
+// calls fn for every cell the segment a-b passes through, walking it one column at a time
+static void traverseSegment(LineGrid *grid, MapLine *line, Vec2 a, Vec2 b, void (*fn)(LineGrid*, int64_t, int64_t, MapLine*))
+{
+    if(a.x > b.x)
+    {
+        Vec2 t = a;
+        a = b;
+        b = t;
+    }
+
+    int64_t minX = lineCellCoord(a.x), maxX = lineCellCoord(b.x);
+    real_t dx = b.x - a.x;
+    for(int64_t cx = minX; cx <= maxX; ++cx)
+    {
+        real_t x0 = cx == minX ? a.x : cx * LINE_GRID_CELL_SIZE;
+        real_t x1 = cx == maxX ? b.x : (cx + 1) * LINE_GRID_CELL_SIZE;
+        real_t y0 = dx == 0 ? a.y : a.y + (x0 - a.x) / dx * (b.y - a.y);
+        real_t y1 = dx == 0 ? b.y : a.y + (x1 - a.x) / dx * (b.y - a.y);
+        int64_t minY = lineCellCoord(fmin(y0, y1)), maxY = lineCellCoord(fmax(y0, y1));
+        for(int64_t cy = minY; cy <= maxY; ++cy)
+            fn(grid, cx, cy, line);
+    }
+}
+
+void LineGridInsert(LineGrid *grid, MapLine *line, Vec2 a, Vec2 b)
+{
+    traverseSegment(grid, line, a, b, addToCell);
+}
+
+void LineGridRemove(LineGrid *grid, MapLine *line, Vec2 a, Vec2 b)
+{
+    if(grid->numCells == 0) return;
+    traverseSegment(grid, line, a, b, removeFromCell);
+}
+
+#define LINE_DIST_BATCH 64
+
+static void closestInCell(const LineGridCell *cell, const MapHotData *hot, Vec2 pos, real_t maxDist, MapLine **closest, real_t *closestDist)
+{
+    Vec2 a[LINE_DIST_BATCH], b[LINE_DIST_BATCH];
+    real_t dists[LINE_DIST_BATCH];
+    for(uint32_t start = 0; start < cell->count; start += LINE_DIST_BATCH)
+    {
+        uint32_t num = cell->count - start < LINE_DIST_BATCH ? cell->count - start : LINE_DIST_BATCH;
+        for(uint32_t i = 0; i < num; ++i)
+        {
+            size_t slot = cell->lines[start + i]->slot;
+            a[i] = hot->lineA[slot];
+            b[i] = hot->lineB[slot];
+        }
+        MinDistToLines(num, a, b, pos, dists);
+
+        for(uint32_t i = 0; i < num; ++i)
+        {
+            MapLine *line = cell->lines[start + i];
+            if(dists[i] > maxDist) continue;
+            if(dists[i] < *closestDist || (dists[i] == *closestDist && line->slot < (*closest)->slot))
+            {
+                *closestDist = dists[i];
+                *closest = line;
+            }
+        }
+    }
+}
+
+MapLine* LineGridFindClosest(const LineGrid *grid, const MapHotData *hot, Vec2 pos, real_t maxDist)
+{
+    MapLine *closest = NULL;
+    real_t closestDist = INFINITY;
+    if(grid->numCells == 0) return NULL;
+
+    int64_t minX = lineCellCoord(pos.x - maxDist), maxX = lineCellCoord(pos.x + maxDist);
+    int64_t minY = lineCellCoord(pos.y - maxDist), maxY = lineCellCoord(pos.y + maxDist);
+    if((uint64_t)(maxX - minX + 1) * (uint64_t)(maxY - minY + 1) > grid->used)
+    {
+        for(size_t i = 0; i < grid->numCells; ++i)
+        {
+            if(grid->cells[i].lines)
+                closestInCell(&grid->cells[i], hot, pos, maxDist, &closest, &closestDist);
+        }
+        return closest;
+    }
+
+    for(int64_t cy = minY; cy <= maxY; ++cy)
+    {
+        for(int64_t cx = minX; cx <= maxX; ++cx)
+        {
+            const LineGridCell *cell = findCell(grid, cx, cy);
+            if(cell)
+                closestInCell(cell, hot, pos, maxDist, &closest, &closestDist);
+        }
+    }
+    return closest;
+}
+
+static void visitCell(LineGrid *grid, const LineGridCell *cell, MapVisitFn fn, void *user)
+{
+    for(uint32_t i = 0; i < cell->count; ++i)
+    {
+        MapLine *line = cell->lines[i];
+        if(line->gridStamp == grid->stamp)
+            continue;
+        line->gridStamp = grid->stamp;
+        fn(line, user);
+    }
+}
+
+void LineGridQueryBox(LineGrid *grid, BoundingBox box, MapVisitFn fn, void *user)
+{
+    if(grid->numCells == 0) return;
+
+    // lines start out with stamp 0, so skip it when wrapping around
+    if(++grid->stamp == 0)
+        grid->stamp = 1;
+
+    int64_t minX = lineCellCoord(box.min.x), maxX = lineCellCoord(box.max.x);
+    int64_t minY = lineCellCoord(box.min.y), maxY = lineCellCoord(box.max.y);
+    if((uint64_t)(maxX - minX + 1) * (uint64_t)(maxY - minY + 1) > grid->used)
+    {
+        for(size_t i = 0; i < grid->numCells; ++i)
+        {
+            const LineGridCell *cell = &grid->cells[i];
+            if(cell->lines && cell->cx >= minX && cell->cx <= maxX && cell->cy >= minY && cell->cy <= maxY)
+                visitCell(grid, cell, fn, user);
+        }
+        return;
+    }
+
+    for(int64_t cy = minY; cy <= maxY; ++cy)
+    {
+        for(int64_t cx = minX; cx <= maxX; ++cx)
+        {
+            const LineGridCell *cell = findCell(grid, cx, cy);
+            if(cell)
+                visitCell(grid, cell, fn, user);
+        }
+    }
+}
+
+void LineGridFree(LineGrid *grid)
+{
+    for(size_t i = 0; i < grid->numCells; ++i)
+        free(grid->cells[i].lines);
+    free(grid->cells);
+    *grid = (LineGrid){ 0 };
+}
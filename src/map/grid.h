@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../map.h"
+
+#define VERTEX_GRID_CELL_SIZE 32.0
+#define LINE_GRID_CELL_SIZE 64.0
+
+void VertexGridInsert(VertexGrid *grid, MapVertex *vertex);
+void VertexGridRemove(VertexGrid *grid, MapVertex *vertex);
+MapVertex* VertexGridFind(const VertexGrid *grid, Vec2 pos);
+MapVertex* VertexGridFindClosest(const VertexGrid *grid, const MapHotData *hot, Vec2 pos, float radiusSq);
+// visits every vertex inside box
+void VertexGridQueryBox(const VertexGrid *grid, const MapHotData *hot, BoundingBox box, MapVisitFn fn, void *user);
+void VertexGridFree(VertexGrid *grid);
+
+// lines are filed by the segment a-b, removal has to pass the same positions as insertion
+void LineGridInsert(LineGrid *grid, MapLine *line, Vec2 a, Vec2 b);
+void LineGridRemove(LineGrid *grid, MapLine *line, Vec2 a, Vec2 b);
+MapLine* LineGridFindClosest(const LineGrid *grid, const MapHotData *hot, Vec2 pos, real_t maxDist);
+// visits every line filed in a cell overlapping box once, the line itself may still miss the box
+void LineGridQueryBox(LineGrid *grid, BoundingBox box, MapVisitFn fn, void *user);
+void LineGridFree(LineGrid *grid);
@@ -0,0 +1,95 @@
+#include "halfedge.h"
+
+#include "arena.h"
+
+typedef struct HalfEdges
+{
+    HalfEdge *items;
+    size_t count, capacity;
+} HalfEdges;
+
+// reset on every walk, so the stack keeps its memory between calls
+static Arena faceArena = { 0 };
+
+// upper half-plane first, then counter-clockwise within a half, no trig needed
+static inline int halfPlane(Vec2 d)
+{
+    return d.y < 0 || (d.y == 0 && d.x < 0);
+}
+
+static inline bool directionBefore(Vec2 d0, Vec2 d1)
+{
+    int h0 = halfPlane(d0), h1 = halfPlane(d1);
+    if(h0 != h1) return h0 < h1;
+    return d0.x * d1.y - d0.y * d1.x > 0;
+}
+
+static inline Vec2 directionFrom(const MapVertex *vertex, const MapLine *line)
+{
+    const MapVertex *other = line->a == vertex ? line->b : line->a;
+    return (Vec2){ .x = other->pos.x - vertex->pos.x, .y = other->pos.y - vertex->pos.y };
+}
+
+size_t VertexRingInsertPosition(const MapVertex *vertex, const MapLine *line)
+{
+    const Vec2 dir = directionFrom(vertex, line);
+    size_t pos = 0;
+    while(pos < vertex->numAttachedLines && !directionBefore(dir, directionFrom(vertex, vertex->attachedLines[pos])))
+        pos++;
+    return pos;
+}
+
+size_t VertexRingPosition(const MapVertex *vertex, const MapLine *line)
+{
+    return line->a == vertex ? line->aVertIndex : line->bVertIndex;
+}
+
+HalfEdge HalfEdgeNext(HalfEdge edge)
+{
+    // the clockwise neighbour of the arriving line is the sharpest turn, that keeps the face on the same side
+    MapVertex *vertex = HalfEdgeTarget(edge);
+    const size_t n = vertex->numAttachedLines;
+    const size_t pos = VertexRingPosition(vertex, edge.line);
+    MapLine *next = vertex->attachedLines[(pos + n - 1) % n];
+    return (HalfEdge){ .line = next, .back = next->a != vertex };
+}
+
+HalfEdge* FaceBoundary(HalfEdge start, size_t *numEdges)
+{
+    arena_reset(&faceArena);
+    HalfEdges stack = { 0 };
+
+    // walk around the face, a dangling line is walked there and back, so those pairs cancel out
+    HalfEdge edge = start;
+    do
+    {
+        if(stack.count > 0 && HalfEdgeEq(stack.items[stack.count-1], HalfEdgeTwin(edge)))
+            stack.count--;
+        else
+            arena_da_append(&faceArena, &stack, edge);
+        edge = HalfEdgeNext(edge);
+    } while(!HalfEdgeEq(edge, start));
+
+    // the same across the point where the walk closed
+    size_t first = 0;
+    while(stack.count - first >= 2 && HalfEdgeEq(stack.items[first], HalfEdgeTwin(stack.items[stack.count-1])))
+    {
+        first++;
+        stack.count--;
+    }
+
+    *numEdges = stack.count - first;
+    return stack.items + first;
+}
+
+size_t FaceLoop(HalfEdge start, MapLine **loop, size_t maxLoopLength)
+{
+    size_t numLines = 0;
+    HalfEdge *edges = FaceBoundary(start, &numLines);
+    if(numLines == 0 || numLines > maxLoopLength || !HalfEdgeEq(edges[0], start))
+        return 0;
+
+    for(size_t i = 0; i < numLines; ++i)
+        loop[i] = edges[i].line;
+    return numLines;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../map.h"
+
+// every line is a pair of half-edges, the one running a->b and its twin running b->a
+// the lines at a vertex are kept sorted counter-clockwise by direction, which links each half-edge to the next one around its face
+typedef struct HalfEdge
+{
+    MapLine *line;
+    bool back; // runs b->a
+} HalfEdge;
+
+static inline HalfEdge HalfEdgeTwin(HalfEdge edge)
+{
+    return (HalfEdge){ .line = edge.line, .back = !edge.back };
+}
+
+static inline MapVertex* HalfEdgeOrigin(HalfEdge edge)
+{
+    return edge.back ? edge.line->b : edge.line->a;
+}
+
+static inline MapVertex* HalfEdgeTarget(HalfEdge edge)
+{
+    return edge.back ? edge.line->a : edge.line->b;
+}
+
+static inline bool HalfEdgeEq(HalfEdge a, HalfEdge b)
+{
+    return a.line == b.line && a.back == b.back;
+}
+
+// where line goes into the sorted lines of vertex when it gets attached
+size_t VertexRingInsertPosition(const MapVertex *vertex, const MapLine *line);
+// position of line in the sorted lines of vertex, vertex has to be one of its ends
+size_t VertexRingPosition(const MapVertex *vertex, const MapLine *line);
+// the edge leaving the target of edge that continues the face edge belongs to
+HalfEdge HalfEdgeNext(HalfEdge edge);
+
+// the half-edges around the face start belongs to with the dangling lines left out, in walking order
+// start is not necessarily the first one, the memory is reused by the next walk
+HalfEdge* FaceBoundary(HalfEdge start, size_t *numEdges);
+// the lines around the face start belongs to, starting with start
+// dangling lines are left out, 0 if start is one of them or the loop is longer than maxLoopLength
+size_t FaceLoop(HalfEdge start, MapLine **loop, size_t maxLoopLength);
@@ -0,0 +1,114 @@
+#include "hot.h"
+
+#include <stdlib.h>
+
+#define HOT_MIN_CAPACITY 1024
+
+static size_t grow(size_t capacity)
+{
+    return capacity == 0 ? HOT_MIN_CAPACITY : capacity * 2;
+}
+
+void HotAddVertex(MapHotData *hot, MapVertex *vertex)
+{
+    if(hot->numVertices == hot->capVertices)
+    {
+        hot->capVertices = grow(hot->capVertices);
+        hot->vertexPos = realloc(hot->vertexPos, hot->capVertices * sizeof *hot->vertexPos);
+        hot->vertices = realloc(hot->vertices, hot->capVertices * sizeof *hot->vertices);
+    }
+
+    size_t slot = hot->numVertices++;
+    hot->vertexPos[slot] = vertex->pos;
+    hot->vertices[slot] = vertex;
+    vertex->slot = slot;
+}
+
+void HotRemoveVertex(MapHotData *hot, MapVertex *vertex)
+{
+    // move the last vertex into the freed slot to keep the arrays dense
+    size_t slot = vertex->slot, last = --hot->numVertices;
+    if(slot != last)
+    {
+        hot->vertexPos[slot] = hot->vertexPos[last];
+        hot->vertices[slot] = hot->vertices[last];
+        hot->vertices[slot]->slot = slot;
+    }
+}
+
+void HotAddLine(MapHotData *hot, MapLine *line)
+{
+    if(hot->numLines == hot->capLines)
+    {
+        hot->capLines = grow(hot->capLines);
+        hot->lineA = realloc(hot->lineA, hot->capLines * sizeof *hot->lineA);
+        hot->lineB = realloc(hot->lineB, hot->capLines * sizeof *hot->lineB);
+        hot->lines = realloc(hot->lines, hot->capLines * sizeof *hot->lines);
+    }
+
+    size_t slot = hot->numLines++;
+    hot->lines[slot] = line;
+    line->slot = slot;
+    HotUpdateLine(hot, line);
+}
+
+void HotUpdateLine(MapHotData *hot, MapLine *line)
+{
+    hot->lineA[line->slot] = line->a->pos;
+    hot->lineB[line->slot] = line->b->pos;
+}
+
+void HotRemoveLine(MapHotData *hot, MapLine *line)
+{
+    size_t slot = line->slot, last = --hot->numLines;
+    if(slot != last)
+    {
+        hot->lineA[slot] = hot->lineA[last];
+        hot->lineB[slot] = hot->lineB[last];
+        hot->lines[slot] = hot->lines[last];
+        hot->lines[slot]->slot = slot;
+    }
+}
+
+void HotAddSector(MapHotData *hot, MapSector *sector)
+{
+    if(hot->numSectors == hot->capSectors)
+    {
+        hot->capSectors = grow(hot->capSectors);
+        hot->sectorBB = realloc(hot->sectorBB, hot->capSectors * sizeof *hot->sectorBB);
+        hot->sectors = realloc(hot->sectors, hot->capSectors * sizeof *hot->sectors);
+    }
+
+    size_t slot = hot->numSectors++;
+    hot->sectors[slot] = sector;
+    sector->slot = slot;
+    HotUpdateSector(hot, sector);
+}
+
+void HotUpdateSector(MapHotData *hot, MapSector *sector)
+{
+    hot->sectorBB[sector->slot] = sector->bb;
+}
+
+void HotRemoveSector(MapHotData *hot, MapSector *sector)
+{
+    size_t slot = sector->slot, last = --hot->numSectors;
+    if(slot != last)
+    {
+        hot->sectorBB[slot] = hot->sectorBB[last];
+        hot->sectors[slot] = hot->sectors[last];
+        hot->sectors[slot]->slot = slot;
+    }
+}
+
+void HotFree(MapHotData *hot)
+{
+    free(hot->vertexPos);
+    free(hot->vertices);
+    free(hot->lineA);
+    free(hot->lineB);
+    free(hot->lines);
+    free(hot->sectorBB);
+    free(hot->sectors);
+    *hot = (MapHotData){ 0 };
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "../map.h"
+
+void HotAddVertex(MapHotData *hot, MapVertex *vertex);
+void HotRemoveVertex(MapHotData *hot, MapVertex *vertex);
+void HotAddLine(MapHotData *hot, MapLine *line);
+void HotUpdateLine(MapHotData *hot, MapLine *line);
+void HotRemoveLine(MapHotData *hot, MapLine *line);
+void HotAddSector(MapHotData *hot, MapSector *sector);
+void HotUpdateSector(MapHotData *hot, MapSector *sector);
+void HotRemoveSector(MapHotData *hot, MapSector *sector);
+void HotFree(MapHotData *hot);
@@ -0,0 +1,259 @@
+#include "index.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "logging.h"
+
+#define INDEX_MIN_CAPACITY 1024
+#define LINE_TABLE_MIN_BUCKETS 1024
+#define SECTOR_TABLE_MIN_BUCKETS 256
+
+void IndexSet(MapIndex *index, size_t idx, void *element)
+{
+    if(idx >= index->capacity)
+    {
+        // map files have their indices bounded by BuildMap, anything past this is a corrupt index
+        if(idx >= SIZE_MAX / 2 / sizeof *index->items)
+        {
+            LogError("Map index %zu out of range", idx);
+            return;
+        }
+        size_t newCapacity = index->capacity == 0 ? INDEX_MIN_CAPACITY : index->capacity;
+        while(idx >= newCapacity) newCapacity *= 2;
+        void **items = realloc(index->items, newCapacity * sizeof *index->items);
+        if(!items)
+        {
+            LogError("Failed to grow the map index to %zu entries", newCapacity);
+            return;
+        }
+        index->items = items;
+        memset(index->items + index->capacity, 0, (newCapacity - index->capacity) * sizeof *index->items);
+        index->capacity = newCapacity;
+    }
+    index->items[idx] = element;
+}
+
+void IndexUnset(MapIndex *index, size_t idx, void *element)
+{
+    // only clear the slot if it still belongs to the element, duplicate indices from a map file may have taken it over
+    if(idx < index->capacity && index->items[idx] == element)
+        index->items[idx] = NULL;
+}
+
+void* IndexGet(const MapIndex *index, size_t idx)
+{
+    if(idx >= index->capacity) return NULL;
+    return index->items[idx];
+}
+
+void IndexFree(MapIndex *index)
+{
+    free(index->items);
+    *index = (MapIndex){ 0 };
+}
+
+static inline size_t pairBucket(size_t numBuckets, const MapVertex *v0, const MapVertex *v1)
+{
+    // the pair is unordered, a line from v0 to v1 is the same line as one from v1 to v0
+    uintptr_t lo = (uintptr_t)v0 < (uintptr_t)v1 ? (uintptr_t)v0 : (uintptr_t)v1;
+    uintptr_t hi = (uintptr_t)v0 < (uintptr_t)v1 ? (uintptr_t)v1 : (uintptr_t)v0;
+    uint64_t h = (uint64_t)lo * 0x9E3779B97F4A7C15ull ^ (uint64_t)hi * 0xC2B2AE3D27D4EB4Full;
+    h ^= h >> 32;
+    return h & (numBuckets - 1);
+}
+
+static void rehashLines(LineTable *table, size_t numBuckets)
+{
+    MapLine **buckets = calloc(numBuckets, sizeof *buckets);
+    for(size_t i = 0; i < table->numBuckets; ++i)
+    {
+        MapLine *line = table->buckets[i];
+        while(line)
+        {
+            MapLine *next = line->hashNext;
+            size_t b = pairBucket(numBuckets, line->a, line->b);
+            line->hashNext = buckets[b];
+            buckets[b] = line;
+            line = next;
+        }
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->numBuckets = numBuckets;
+}
+
+void LineTableInsert(LineTable *table, MapLine *line)
+{
+    if(table->count >= table->numBuckets)
+        rehashLines(table, table->numBuckets == 0 ? LINE_TABLE_MIN_BUCKETS : table->numBuckets * 2);
+
+    size_t b = pairBucket(table->numBuckets, line->a, line->b);
+    line->hashNext = table->buckets[b];
+    table->buckets[b] = line;
+    table->count++;
+}
+
+void LineTableRemove(LineTable *table, MapLine *line)
+{
+    if(table->numBuckets == 0) return;
+
+    MapLine **link = &table->buckets[pairBucket(table->numBuckets, line->a, line->b)];
+    while(*link && *link != line)
+        link = &(*link)->hashNext;
+
+    if(*link)
+    {
+        *link = line->hashNext;
+        line->hashNext = NULL;
+        table->count--;
+    }
+}
+
+MapLine* LineTableFind(const LineTable *table, const MapVertex *v0, const MapVertex *v1)
+{
+    if(table->numBuckets == 0) return NULL;
+
+    for(MapLine *line = table->buckets[pairBucket(table->numBuckets, v0, v1)]; line; line = line->hashNext)
+    {
+        bool ab = line->a == v0 && line->b == v1;
+        bool ba = line->a == v1 && line->b == v0;
+        if(ab || ba)
+            return line;
+    }
+    return NULL;
+}
+
+void LineTableFree(LineTable *table)
+{
+    free(table->buckets);
+    *table = (LineTable){ 0 };
+}
+
+static inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+uint64_t SectorSignature(size_t numLines, MapLine *lines[static numLines])
+{
+    // summing the mixed line handles gives the same value for every ordering of the loop,
+    // the same as hashing the sorted line set without having to sort it
+    uint64_t signature = mix64(numLines);
+    for(size_t i = 0; i < numLines; ++i)
+        signature += mix64((uintptr_t)lines[i]);
+    return signature;
+}
+
+static inline size_t signatureBucket(size_t numBuckets, uint64_t signature)
+{
+    return (signature ^ (signature >> 32)) & (numBuckets - 1);
+}
+
+static void rehashSectors(SectorTable *table, size_t numBuckets)
+{
+    MapSector **buckets = calloc(numBuckets, sizeof *buckets);
+    for(size_t i = 0; i < table->numBuckets; ++i)
+    {
+        MapSector *sector = table->buckets[i];
+        while(sector)
+        {
+            MapSector *next = sector->hashNext;
+            size_t b = signatureBucket(numBuckets, sector->signature);
+            sector->hashNext = buckets[b];
+            buckets[b] = sector;
+            sector = next;
+        }
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->numBuckets = numBuckets;
+}
+
+static int compareLineIdx(const void *a, const void *b)
+{
+    const MapLine *la = *(MapLine* const*)a, *lb = *(MapLine* const*)b;
+    return (la->idx > lb->idx) - (la->idx < lb->idx);
+}
+
+void SectorTableInsert(SectorTable *table, MapSector *sector)
+{
+    if(table->count >= table->numBuckets)
+        rehashSectors(table, table->numBuckets == 0 ? SECTOR_TABLE_MIN_BUCKETS : table->numBuckets * 2);
+
+    sector->signature = SectorSignature(sector->numOuterLines, sector->outerLines);
+    memcpy(sector->lineSet, sector->outerLines, sector->numOuterLines * sizeof *sector->lineSet);
+    qsort(sector->lineSet, sector->numOuterLines, sizeof *sector->lineSet, compareLineIdx);
+    size_t b = signatureBucket(table->numBuckets, sector->signature);
+    sector->hashNext = table->buckets[b];
+    table->buckets[b] = sector;
+    table->count++;
+}
+
+void SectorTableRemove(SectorTable *table, MapSector *sector)
+{
+    if(table->numBuckets == 0) return;
+
+    MapSector **link = &table->buckets[signatureBucket(table->numBuckets, sector->signature)];
+    while(*link && *link != sector)
+        link = &(*link)->hashNext;
+
+    if(*link)
+    {
+        *link = sector->hashNext;
+        sector->hashNext = NULL;
+        table->count--;
+    }
+}
+
+static bool sameLineSet(const MapSector *sector, size_t numLines, MapLine *sortedLines[static numLines])
+{
+    if(sector->numOuterLines != numLines) return false;
+
+    for(size_t i = 0; i < numLines; ++i)
+    {
+        if(sortedLines[i] != sector->lineSet[i])
+            return false;
+    }
+    return true;
+}
+
+// holds the sorted query, a loop can be far too long for the stack, reset on every lookup
+static Arena queryArena = { 0 };
+
+MapSector* SectorTableFind(const SectorTable *table, size_t numLines, MapLine *lines[static numLines])
+{
+    if(table->numBuckets == 0 || numLines == 0) return NULL;
+
+    uint64_t signature = SectorSignature(numLines, lines);
+    MapLine **sortedLines = NULL;
+    for(MapSector *sector = table->buckets[signatureBucket(table->numBuckets, signature)]; sector; sector = sector->hashNext)
+    {
+        if(sector->signature != signature || sector->numOuterLines != numLines) continue;
+
+        // the query is only sorted once a signature matches, which is practically always the equivalent sector
+        if(!sortedLines)
+        {
+            arena_reset(&queryArena);
+            sortedLines = arena_alloc(&queryArena, numLines * sizeof *sortedLines);
+            memcpy(sortedLines, lines, numLines * sizeof *sortedLines);
+            qsort(sortedLines, numLines, sizeof *sortedLines, compareLineIdx);
+        }
+        if(sameLineSet(sector, numLines, sortedLines))
+            return sector;
+    }
+    return NULL;
+}
+
+void SectorTableFree(SectorTable *table)
+{
+    free(table->buckets);
+    *table = (SectorTable){ 0 };
+}
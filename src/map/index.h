@@ -0,0 +1,19 @@
+#pragma once
+
+#include "../map.h"
+
+void IndexSet(MapIndex *index, size_t idx, void *element);
+void IndexUnset(MapIndex *index, size_t idx, void *element);
+void* IndexGet(const MapIndex *index, size_t idx);
+void IndexFree(MapIndex *index);
+
+void LineTableInsert(LineTable *table, MapLine *line);
+void LineTableRemove(LineTable *table, MapLine *line);
+MapLine* LineTableFind(const LineTable *table, const MapVertex *v0, const MapVertex *v1);
+void LineTableFree(LineTable *table);
+
+uint64_t SectorSignature(size_t numLines, MapLine *lines[static numLines]);
+void SectorTableInsert(SectorTable *table, MapSector *sector);
+void SectorTableRemove(SectorTable *table, MapSector *sector);
+MapSector* SectorTableFind(const SectorTable *table, size_t numLines, MapLine *lines[static numLines]);
+void SectorTableFree(SectorTable *table);
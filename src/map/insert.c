@@ -2,17 +2,25 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "arena.h"
 
 #include "../edit.h"
 #include "../geometry.h"
 #include "../map.h"
+#include "create.h"
+#include "grid.h"
+#include "halfedge.h"
+#include "index.h"
 #include "logging.h"
+#include "props.h"
 #include "remove.h"
 #include "triangulate.h"
 #include "util.h"
 #include "query.h"
+#include "sweep.h"
+#include "tree.h"
 #include "utils.h"
 
 #define MAX_LINES_PER_SECTOR 1024
@@ -37,13 +45,37 @@ static void insert(size_t size, size_t *num, void *elements[static size], void *
     }
 }
 
-MapSector* MakeMapSector(Map *map, MapLine *startLine, SectorData data)
+typedef struct SectorCandidates
+{
+    MapLine **items;
+    size_t count, capacity;
+    Arena *arena;
+} SectorCandidates;
+
+static void addSectorCandidate(void *element, void *user)
+{
+    SectorCandidates *candidates = user;
+    arena_da_append(candidates->arena, candidates, (MapLine*)element);
+}
+
+static int compareLineIdx(const void *a, const void *b)
+{
+    const MapLine *la = *(MapLine * const *)a, *lb = *(MapLine * const *)b;
+    return (la->idx > lb->idx) - (la->idx < lb->idx);
+}
+
+// front makes the sector in front of startLine, otherwise behind it
+static MapSector* makeSectorOnSide(Map *map, MapLine *startLine, bool front, SectorData data)
 {
     MapLine *sectorLines[MAX_LINES_PER_SECTOR] = { 0 };
-    size_t numLines = FindOuterLineLoop(startLine, sectorLines, MAX_LINES_PER_SECTOR);
+    size_t numLines = front ? FindOuterLineLoop(startLine, sectorLines, MAX_LINES_PER_SECTOR) : FindInnerLineLoop(startLine, sectorLines, MAX_LINES_PER_SECTOR);
     if(numLines == 0) return NULL;
     if(FindEquivalentSector(map, numLines, sectorLines)) return NULL;
     struct Polygon *poly = PolygonFromMapLines(numLines, sectorLines);
+    // grown by EPSILON since the polygon test treats points that close to an edge as on it
+    BoundingBox polyBB = BoundingBoxFromVertices(poly->length, (Vec2*)poly->vertices);
+    polyBB.min = vec2_sub(polyBB.min, (Vec2){ EPSILON, EPSILON });
+    polyBB.max = vec2_add(polyBB.max, (Vec2){ EPSILON, EPSILON });
 
     Arena arena = { 0 };
 
@@ -53,13 +85,26 @@ MapSector* MakeMapSector(Map *map, MapLine *startLine, SectorData data)
     MapLine **usedLines = arena_alloc(&arena, usedLinesSize * sizeof *usedLines);
     MapLine **potentialLines = arena_alloc(&arena, sizePotentialLines * sizeof *potentialLines);
 
-    for(MapLine *line = map->headLine; line; line = line->next)
+    // only lines inside the box can be inside the polygon, in creation order like a walk of the line list
+    SectorCandidates candidates = { .arena = &arena };
+    LineGridQueryBox(&map->lineGrid, polyBB, addSectorCandidate, &candidates);
+    if(candidates.count > 1)
+        qsort(candidates.items, candidates.count, sizeof *candidates.items, compareLineIdx);
+
+    for(size_t c = 0; c < candidates.count && numPotentialLines < sizePotentialLines; ++c)
     {
+        MapLine *line = candidates.items[c];
         if(includes(numLines, (void**)sectorLines, line))
             continue;
 
-        bool aIn = PointInPolygon(poly, line->a->pos);
-        bool bIn = PointInPolygon(poly, line->b->pos);
+        Vec2 a = line->a->pos, b = line->b->pos;
+        if(a.x < polyBB.min.x || a.x > polyBB.max.x || a.y < polyBB.min.y || a.y > polyBB.max.y)
+            continue;
+        if(b.x < polyBB.min.x || b.x > polyBB.max.x || b.y < polyBB.min.y || b.y > polyBB.max.y)
+            continue;
+
+        bool aIn = PointInPolygon(poly, a);
+        bool bIn = PointInPolygon(poly, b);
         if(aIn && bIn)
             potentialLines[numPotentialLines++] = line;
     }
@@ -108,7 +153,12 @@ MapSector* MakeMapSector(Map *map, MapLine *startLine, SectorData data)
     return sector;
 }
 
-#define QUEUE_SIZE (4096)
+MapSector* MakeMapSector(Map *map, MapLine *startLine, SectorData data)
+{
+    return makeSectorOnSide(map, startLine, true, data);
+}
+
+#define QUEUE_MIN_CAPACITY 256
 
 typedef struct QueueElement
 {
@@ -118,31 +168,45 @@ typedef struct QueueElement
 
 typedef struct LineQueue
 {
-    QueueElement elements[QUEUE_SIZE];
-    size_t head, tail, numLines;
+    QueueElement *elements;
+    size_t capacity, head, tail, numLines;
 } LineQueue;
 
-static inline bool Enqueue(LineQueue *queue, line_t line, bool potentialStart)
+// backs the queue, reset after every insert so the memory is reused by the next one
+static Arena queueArena = { 0 };
+
+static inline void Enqueue(LineQueue *queue, line_t line, bool potentialStart)
 {
+    if(queue->numLines == queue->capacity)
+    {
+        // unwrap the ring into a buffer twice the size
+        size_t capacity = queue->capacity ? queue->capacity * 2 : QUEUE_MIN_CAPACITY;
+        QueueElement *elements = arena_alloc(&queueArena, capacity * sizeof *elements);
+        for(size_t i = 0; i < queue->numLines; ++i)
+            elements[i] = queue->elements[(queue->head + i) % queue->capacity];
+        queue->elements = elements;
+        queue->capacity = capacity;
+        queue->head = 0;
+        queue->tail = queue->numLines;
+    }
     queue->elements[queue->tail] = (QueueElement){ .line = line, .potentialStart = potentialStart };
-    queue->tail = (queue->tail + 1) % QUEUE_SIZE;
+    queue->tail = (queue->tail + 1) % queue->capacity;
     queue->numLines++;
-    //assert(queue->numLines < QUEUE_SIZE);
-    return queue->numLines < QUEUE_SIZE;
 }
 
 static inline QueueElement Dequeue(LineQueue *queue)
 {
     QueueElement el = queue->elements[queue->head];
-    queue->head = (queue->head + 1) % QUEUE_SIZE;
+    queue->head = (queue->head + 1) % queue->capacity;
     queue->numLines--;
     return el;
 }
 
+// a sector an edit touched, the rebuild checks whether it still matches its face
 typedef struct SectorUpdateItem
 {
-    MapLine *line;
-    SectorData sectorData;
+    MapSector *sector;
+    size_t idx; // the sector may be gone by the time the update runs
 } SectorUpdateItem;
 
 typedef struct SectorUpdate
@@ -153,123 +217,406 @@ typedef struct SectorUpdate
 
 static Arena sectorUpdateArena = { 0 };
 
-static inline void InsertSectorUpdate(SectorUpdate *sectorUpdate, MapLine *line, SectorData sectorData)
+static inline void InsertSectorUpdate(SectorUpdate *sectorUpdate, MapSector *sector)
 {
-    SectorUpdateItem item = { .line = line, .sectorData = sectorData };
+    if(!sector) return;
+    SectorUpdateItem item = { .sector = sector, .idx = sector->idx };
     arena_da_append(&sectorUpdateArena, sectorUpdate, item);
 }
 
-static void DoSplit(Map *map, SectorUpdate *sectorUpdate, MapLine *line, MapVertex *vertex)
+// where a line that is about to be split sits in the sector on one of its sides
+typedef struct SplitSide
 {
-    SectorData frontData = DefaultSectorData();
-    SectorData backData = DefaultSectorData();
-    bool hasFrontSector = line->frontSector != NULL;
-    bool hasBackSector = line->backSector != NULL;
-    bool hasSectorsAttached = hasFrontSector || hasBackSector;
+    MapSector *sector;
+    size_t loop; // 0 for the outer loop, 1 + the hole for a loop around a hole, past the holes if the line is in none
+    size_t index; // position in the loop
+    bool forward; // the loop runs along the line from a to b
+} SplitSide;
 
-    if(hasFrontSector)
+static bool findInLoop(size_t numLines, MapLine *lines[static numLines], MapLine *line, SplitSide *side)
+{
+    for(size_t i = 0; i < numLines; ++i)
     {
-        frontData = CopySectorData(line->frontSector->data);
-        MapSector *sector = line->frontSector;
-        for(size_t i = 0; i < sector->numOuterLines; ++i)
-        {
-            MapLine *sline = sector->outerLines[i];
-            if(sline == line) continue;
-            sline->mark = true;
-            InsertSectorUpdate(sectorUpdate, sline, frontData);
-        }
-        RemoveSector(map, sector);
+        if(lines[i] != line) continue;
+        // a loop always starts with a line from a to b, any other one is entered from the line before it
+        MapLine *prev = lines[i == 0 ? numLines - 1 : i - 1];
+        side->index = i;
+        side->forward = i == 0 || prev->a == line->a || prev->b == line->a;
+        return true;
     }
-    if(hasBackSector)
+    return false;
+}
+
+static SplitSide splitSide(MapSector *sector, MapLine *line)
+{
+    SplitSide side = { .sector = sector };
+    if(!sector) return side;
+
+    if(findInLoop(sector->numOuterLines, sector->outerLines, line, &side))
+        return side;
+    for(side.loop = 1; side.loop <= sector->numInnerLines; ++side.loop)
     {
-        backData = CopySectorData(line->backSector->data);
-        MapSector *sector = line->backSector;
-        for(size_t i = 0; i < sector->numOuterLines; ++i)
-        {
-            MapLine *sline = sector->outerLines[i];
-            if(sline == line) continue;
-            sline->mark = true;
-            InsertSectorUpdate(sectorUpdate, sline, backData);
-        }
-        RemoveSector(map, sector);
+        if(findInLoop(sector->numInnerLinesNum[side.loop - 1], sector->innerLines[side.loop - 1], line, &side))
+            break;
     }
+    return side;
+}
+
+// puts the pieces of a split line, given from its a to its b, where the line was in the sector
+// the area of the sector stays the same, so it keeps its identity, data and triangulation
+static void patchSplitSide(Map *map, SectorUpdate *sectorUpdate, SplitSide side, bool front, size_t numPieces, MapLine *pieces[static numPieces])
+{
+    MapSector *sector = side.sector;
+    // a line that is in none of the sector's loops gives its pieces no reason to point at it
+    if(!sector || side.loop > sector->numInnerLines) return;
+
+    for(size_t i = 0; i < numPieces; ++i)
+    {
+        if(front)
+            pieces[i]->frontSector = sector;
+        else
+            pieces[i]->backSector = sector;
+    }
+
+    MapLine **lines;
+    if(side.loop == 0)
+    {
+        SectorTableRemove(&map->sectorTable, sector);
+        const size_t oldNumLines = sector->numOuterLines;
+        ResizeSectorOuterLines(map, sector, oldNumLines + numPieces - 1);
+        memmove(sector->outerLines + side.index + numPieces, sector->outerLines + side.index + 1, (oldNumLines - side.index - 1) * sizeof *sector->outerLines);
+        lines = sector->outerLines;
+    }
+    else
+    {
+        const size_t hole = side.loop - 1;
+        const size_t oldNumLines = sector->numInnerLinesNum[hole];
+        sector->numInnerLinesNum[hole] = oldNumLines + numPieces - 1;
+        sector->innerLines[hole] = BlockRealloc(&map->elementHeap, sector->innerLines[hole], sector->numInnerLinesNum[hole] * sizeof **sector->innerLines);
+        memmove(sector->innerLines[hole] + side.index + numPieces, sector->innerLines[hole] + side.index + 1, (oldNumLines - side.index - 1) * sizeof **sector->innerLines);
+        lines = sector->innerLines[hole];
+    }
+
+    for(size_t i = 0; i < numPieces; ++i)
+        lines[side.index + i] = pieces[side.forward ? i : numPieces - 1 - i];
+    if(side.loop == 0)
+        SectorTableInsert(&map->sectorTable, sector);
+
+    InsertSectorUpdate(sectorUpdate, sector);
+}
+
+// what a cancelled insert needs to put the map back, only splits change the lines and sectors that were there before it
+typedef struct SplitLine
+{
+    size_t idx;
+    MapVertex *a, *b;
+    LineData data;
+    PropertyTable props;
+    MapSector *frontSector, *backSector;
+} SplitLine;
+
+typedef struct SplitLines
+{
+    SplitLine *items;
+    size_t count, capacity;
+} SplitLines;
+
+// the pieces of line that took its place in a loop of sector
+typedef struct LoopPatch
+{
+    MapSector *sector;
+    size_t loop, index, numPieces;
+    size_t line;
+} LoopPatch;
+
+typedef struct LoopPatches
+{
+    LoopPatch *items;
+    size_t count, capacity;
+} LoopPatches;
+
+typedef struct InsertJournal
+{
+    // everything at or past these was added by the insert
+    size_t firstVertexIdx, firstLineIdx;
+    SplitLines lines;
+    LoopPatches patches;
+} InsertJournal;
+
+static Arena journalArena = { 0 };
+
+static void journalSplit(InsertJournal *journal, MapLine *line, size_t numPieces, SplitSide front, SplitSide back)
+{
+    if(!journal) return;
+
+    if(line->idx < journal->firstLineIdx)
+    {
+        SplitLine split = {
+            .idx = line->idx, .a = line->a, .b = line->b,
+            .data = CopyLineData(line->data), .props = line->props,
+            .frontSector = line->frontSector, .backSector = line->backSector
+        };
+        // the props move into the journal, the line is freed by the split
+        line->props = (PropertyTable){ 0 };
+        arena_da_append(&journalArena, &journal->lines, split);
+    }
+
+    SplitSide sides[] = { front, back };
+    for(size_t i = 0; i < 2; ++i)
+    {
+        // the same test patchSplitSide makes
+        MapSector *sector = sides[i].sector;
+        if(!sector || sides[i].loop > sector->numInnerLines) continue;
+        LoopPatch patch = { .sector = sector, .loop = sides[i].loop, .index = sides[i].index, .numPieces = numPieces, .line = line->idx };
+        arena_da_append(&journalArena, &journal->patches, patch);
+    }
+}
+
+static SplitResult DoSplit(Map *map, SectorUpdate *sectorUpdate, InsertJournal *journal, MapLine *line, MapVertex *vertex)
+{
+    SplitSide front = splitSide(line->frontSector, line);
+    SplitSide back = splitSide(line->backSector, line);
+    journalSplit(journal, line, 2, front, back);
 
     SplitResult result = SplitMapLine(map, line, vertex);
-    if(hasSectorsAttached)
+    MapLine *pieces[] = { result.left, result.right };
+    patchSplitSide(map, sectorUpdate, front, true, 2, pieces);
+    patchSplitSide(map, sectorUpdate, back, false, 2, pieces);
+    return result;
+}
+
+static void DoSplit2(Map *map, SectorUpdate *sectorUpdate, InsertJournal *journal, MapLine *line, MapVertex *vertexA, MapVertex *vertexB)
+{
+    SplitSide front = splitSide(line->frontSector, line);
+    SplitSide back = splitSide(line->backSector, line);
+    journalSplit(journal, line, 3, front, back);
+
+    SplitResult result = SplitMapLine2(map, line, vertexA, vertexB);
+    MapLine *pieces[] = { result.left, result.middle, result.right };
+    patchSplitSide(map, sectorUpdate, front, true, 3, pieces);
+    patchSplitSide(map, sectorUpdate, back, false, 3, pieces);
+}
+
+// collapses the pieces of a patch back into the line they replaced
+static void unpatchLoop(Map *map, const LoopPatch *patch)
+{
+    MapSector *sector = patch->sector;
+    // a piece that was split again later is gone, the patch that made it puts its line back over it
+    MapLine *line = GetLine(map, patch->line);
+    const size_t tail = patch->index + patch->numPieces;
+
+    if(patch->loop == 0)
     {
-        result.left->mark = true;
-        result.right->mark = true;
-        if(hasFrontSector)
-        {
-            InsertSectorUpdate(sectorUpdate, result.left, frontData);
-            InsertSectorUpdate(sectorUpdate, result.right, frontData);
-        }
-        if(hasBackSector)
-        {
-            InsertSectorUpdate(sectorUpdate, result.left, backData);
-            InsertSectorUpdate(sectorUpdate, result.right, backData);
-        }
+        const size_t numLines = sector->numOuterLines;
+        memmove(sector->outerLines + patch->index + 1, sector->outerLines + tail, (numLines - tail) * sizeof *sector->outerLines);
+        sector->outerLines[patch->index] = line;
+        ResizeSectorOuterLines(map, sector, numLines - patch->numPieces + 1);
+    }
+    else
+    {
+        const size_t hole = patch->loop - 1;
+        const size_t numLines = sector->numInnerLinesNum[hole];
+        MapLine **lines = sector->innerLines[hole];
+        memmove(lines + patch->index + 1, lines + tail, (numLines - tail) * sizeof *lines);
+        lines[patch->index] = line;
+        sector->numInnerLinesNum[hole] = numLines - patch->numPieces + 1;
+        sector->innerLines[hole] = BlockRealloc(&map->elementHeap, lines, sector->numInnerLinesNum[hole] * sizeof *lines);
     }
 }
 
-static void DoSplit2(Map *map, SectorUpdate *sectorUpdate, MapLine *line, MapVertex *vertexA, MapVertex *vertexB)
+// puts the map back the way it was before the insert, the sectors were not rebuilt yet so they are all still there
+static void rollbackInsert(Map *map, InsertJournal *journal)
 {
-    SectorData frontData = DefaultSectorData();
-    SectorData backData = DefaultSectorData();
-    bool hasFrontSector = line->frontSector != NULL;
-    bool hasBackSector = line->backSector != NULL;
-    bool hasSectorsAttached = hasFrontSector || hasBackSector;
+    const size_t lastVertexIdx = map->vertexIdx, lastLineIdx = map->lineIdx;
 
-    if(hasFrontSector)
+    // the split lines come back under their old index, the pieces stay until the loops no longer need them
+    for(size_t i = 0; i < journal->lines.count; ++i)
     {
-        frontData = CopySectorData(line->frontSector->data);
-        MapSector *sector = line->frontSector;
-        for(size_t i = 0; i < sector->numOuterLines; ++i)
-        {
-            MapLine *sline = sector->outerLines[i];
-            if(sline == line) continue;
-            sline->mark = true;
-            InsertSectorUpdate(sectorUpdate, sline, frontData);
-        }
-        RemoveSector(map, sector);
+        SplitLine *split = &journal->lines.items[i];
+        MapLine *line = CreateLineUnchecked(map, split->idx, split->a, split->b, split->data);
+        FreeLineData(split->data);
+        line->props = split->props;
+        line->frontSector = split->frontSector;
+        line->backSector = split->backSector;
     }
-    if(hasBackSector)
+
+    // the loops pass through pieces that are already gone, so the sectors stay out of the table until they are whole again
+    for(size_t i = 0; i < journal->patches.count; ++i)
     {
-        backData = CopySectorData(line->backSector->data);
-        MapSector *sector = line->backSector;
-        for(size_t i = 0; i < sector->numOuterLines; ++i)
+        if(journal->patches.items[i].loop == 0)
+            SectorTableRemove(&map->sectorTable, journal->patches.items[i].sector);
+    }
+    for(size_t i = journal->patches.count; i-- > 0;)
+        unpatchLoop(map, &journal->patches.items[i]);
+    for(size_t i = 0; i < journal->patches.count; ++i)
+    {
+        MapSector *sector = journal->patches.items[i].sector;
+        if(journal->patches.items[i].loop != 0) continue;
+        // removing first keeps a sector patched several times in the table once
+        SectorTableRemove(&map->sectorTable, sector);
+        SectorTableInsert(&map->sectorTable, sector);
+    }
+
+    for(size_t idx = journal->firstLineIdx; idx < lastLineIdx; ++idx)
+    {
+        MapLine *line = GetLine(map, idx);
+        if(line) RemoveLine(map, line);
+    }
+    for(size_t idx = journal->firstVertexIdx; idx < lastVertexIdx; ++idx)
+    {
+        MapVertex *vertex = GetVertex(map, idx);
+        if(vertex) RemoveVertex(map, vertex);
+    }
+
+    arena_reset(&journalArena);
+}
+
+static void commitInsert(Map *map, InsertJournal *journal)
+{
+    // the pieces got copies of the data, props stayed with the line they were set on
+    for(size_t i = 0; i < journal->lines.count; ++i)
+    {
+        FreeLineData(journal->lines.items[i].data);
+        FreeProperties(map, &journal->lines.items[i].props);
+    }
+    arena_reset(&journalArena);
+}
+
+static int compareUpdates(const void *a, const void *b)
+{
+    const SectorUpdateItem *ua = a, *ub = b;
+    return (ua->idx > ub->idx) - (ua->idx < ub->idx);
+}
+
+// walking the face from one of the sector's lines comes around its outer loop and nothing else
+static bool matchesFace(MapSector *sector)
+{
+    MapLine *line = sector->outerLines[0];
+    if(line->frontSector != sector && line->backSector != sector) return false;
+
+    size_t numEdges = 0;
+    HalfEdge *edges = FaceBoundary((HalfEdge){ .line = line, .back = line->frontSector != sector }, &numEdges);
+    if(numEdges != sector->numOuterLines) return false;
+    for(size_t i = 0; i < numEdges; ++i)
+    {
+        if((edges[i].back ? edges[i].line->backSector : edges[i].line->frontSector) != sector)
+            return false;
+    }
+    return true;
+}
+
+typedef struct NewSectors
+{
+    MapSector **items;
+    size_t count, capacity;
+} NewSectors;
+
+// only the touched sectors whose face changed are rebuilt, each face inside one gets a sector with its data
+static void RebuildSectors(Map *map, SectorUpdate *sectorsToUpdate)
+{
+    if(sectorsToUpdate->count > 1)
+        qsort(sectorsToUpdate->items, sectorsToUpdate->count, sizeof *sectorsToUpdate->items, compareUpdates);
+
+    for(size_t i = 0; i < sectorsToUpdate->count; ++i)
+    {
+        const SectorUpdateItem item = sectorsToUpdate->items[i];
+        if(i > 0 && sectorsToUpdate->items[i-1].idx == item.idx) continue;
+
+        MapSector *sector = GetSector(map, item.idx);
+        if(sector != item.sector || matchesFace(sector)) continue;
+
+        // the outline comes first, followed by the loops around the holes
+        const size_t numLines = sector->numOuterLines;
+        size_t numRingLines = numLines;
+        for(size_t h = 0; h < sector->numInnerLines; ++h)
+            numRingLines += sector->numInnerLinesNum[h];
+        MapLine **lines = arena_alloc(&sectorUpdateArena, numRingLines * sizeof *lines);
+        bool *front = arena_alloc(&sectorUpdateArena, numLines * sizeof *front);
+        for(size_t j = 0; j < numLines; ++j)
+        {
+            lines[j] = sector->outerLines[j];
+            front[j] = lines[j]->frontSector == sector;
+        }
+        for(size_t h = 0, j = numLines; h < sector->numInnerLines; ++h)
         {
-            MapLine *sline = sector->outerLines[i];
-            if(sline == line) continue;
-            sline->mark = true;
-            InsertSectorUpdate(sectorUpdate, sline, backData);
+            memcpy(lines + j, sector->innerLines[h], sector->numInnerLinesNum[h] * sizeof *lines);
+            j += sector->numInnerLinesNum[h];
         }
+
+        SectorData data = CopySectorData(sector->data);
         RemoveSector(map, sector);
-    }
 
-    SplitResult result = SplitMapLine2(map, line, vertexA, vertexB);
-    if(hasSectorsAttached)
-    {
-        result.left->mark = true;
-        result.right->mark = true;
-        result.middle->mark = true;
-        if(hasFrontSector)
+        // the old rings bound the region, faces inside it are reached across the lines that split it
+        // and the holes stay empty, only the outline seeds the new sectors
+        for(size_t j = 0; j < numRingLines; ++j)
+            lines[j]->mark = true;
+
+        NewSectors created = { 0 };
+        for(size_t j = 0; j < numLines; ++j)
         {
-            InsertSectorUpdate(sectorUpdate, result.left, frontData);
-            InsertSectorUpdate(sectorUpdate, result.right, frontData);
-            InsertSectorUpdate(sectorUpdate, result.middle, frontData);
+            if(front[j] ? lines[j]->frontSector : lines[j]->backSector) continue;
+            MapSector *newSector = makeSectorOnSide(map, lines[j], front[j], data);
+            if(newSector) arena_da_append(&sectorUpdateArena, &created, newSector);
         }
-        if(hasBackSector)
+
+        for(size_t j = 0; j < created.count; ++j)
         {
-            InsertSectorUpdate(sectorUpdate, result.left, backData);
-            InsertSectorUpdate(sectorUpdate, result.right, backData);
-            InsertSectorUpdate(sectorUpdate, result.middle, backData);
+            MapSector *newSector = created.items[j];
+            for(size_t k = 0; k < newSector->numOuterLines; ++k)
+            {
+                MapLine *line = newSector->outerLines[k];
+                if(line->mark) continue;
+                bool otherFront = line->backSector == newSector;
+                if(otherFront ? line->frontSector : line->backSector) continue;
+                MapSector *other = makeSectorOnSide(map, line, otherFront, data);
+                if(other) arena_da_append(&sectorUpdateArena, &created, other);
+            }
         }
+
+        for(size_t j = 0; j < numRingLines; ++j)
+            lines[j]->mark = false;
+        FreeSectorData(data);
     }
+
+    arena_reset(&sectorUpdateArena);
 }
 
-bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts], bool isLoop)
+typedef struct LineCandidates
+{
+    MapLine **items;
+    size_t count, capacity;
+} LineCandidates;
+
+static Arena candidateArena = { 0 };
+
+static void addCandidate(void *element, void *user)
 {
+    arena_da_append(&candidateArena, (LineCandidates*)user, (MapLine*)element);
+}
+
+// intersections are accepted slightly past the segment ends, so the box is grown by that much
+static BoundingBox SegmentBox(line_t line)
+{
+    const real_t pad = SMALL_NUM * vec2_distance(line.a, line.b) + EPSILON;
+    return (BoundingBox){
+        .min = { .x = min(line.a.x, line.b.x) - pad, .y = min(line.a.y, line.b.y) - pad },
+        .max = { .x = max(line.a.x, line.b.x) + pad, .y = max(line.a.y, line.b.y) + pad }
+    };
+}
+
+// lines whose grid cells overlap the segment, in creation order so the first hit is the same one a walk of the line list finds
+static LineCandidates QueryCandidates(Map *map, line_t line)
+{
+    LineCandidates candidates = { 0 };
+    LineGridQueryBox(&map->lineGrid, SegmentBox(line), addCandidate, &candidates);
+    if(candidates.count > 1)
+        qsort(candidates.items, candidates.count, sizeof *candidates.items, compareLineIdx);
+    return candidates;
+}
+
+bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts], bool isLoop, InsertProgressFn progress, void *user)
+{
+    bool ok = true;
     bool didIntersect = false;
     size_t end = isLoop ? numVerts : numVerts - 1;
 
@@ -292,6 +639,7 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
     size_t numNewLines = 0;
 
     SectorUpdate sectorsToUpdate = { 0 };
+    InsertJournal journal = { .firstVertexIdx = map->vertexIdx, .firstLineIdx = map->lineIdx };
 
     // insert the drawn lines into queue
     for(size_t i = 0; i < end; ++i)
@@ -299,12 +647,21 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
         Vec2 a = vertices[i];
         Vec2 b = vertices[(i+1) % numVerts];
 
-        if(!Enqueue(&queue, (line_t){ .a = a, .b = b }, i == 0)) return false;
+        Enqueue(&queue, (line_t){ .a = a, .b = b }, i == 0);
     }
 
     LogDebug("Start inserting...");
+    size_t processed = 0;
     while(queue.numLines > 0)
     {
+        if(progress && !progress(processed, queue.numLines, user))
+        {
+            LogDebug("Inserting cancelled with %zu lines left", queue.numLines);
+            ok = false;
+            break;
+        }
+        processed++;
+
         QueueElement el = Dequeue(&queue);
         LogDebug("Remove 1 (%zu)", queue.numLines);
         line_t line = el.line;
@@ -312,9 +669,11 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
         bool potentialStart = el.potentialStart;
 
         bool canInsertLine = true;
-        MapLine *mapLine = map->headLine;
-        while(mapLine != NULL)
+        arena_reset(&candidateArena);
+        LineCandidates candidates = QueryCandidates(map, line);
+        for(size_t c = 0; c < candidates.count && canInsertLine; ++c)
         {
+            MapLine *mapLine = candidates.items[c];
             line_t mline = { .a = mapLine->a->pos, .b = mapLine->b->pos };
 
             intersection_res_t intersection = { 0 };
@@ -333,14 +692,14 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                     {
                         LogDebug("-> start at end point and end outside");
                         line_t line1 = { mline.b, line.b };
-                        if(!Enqueue(&queue, line1, true)) return false;
+                        Enqueue(&queue, line1, true);
                         LogDebug("Add 1 %s(%s:%d)", __FUNCTION__, __FILE__, __LINE__);
                     }
                     else if(lt(u1, 1))
                     {
                         LogDebug("-> start at end point and end inside");
                         MapVertex *splitVertex = EditAddVertex(map, intersection.p1);
-                        DoSplit(map, &sectorsToUpdate, mapLine, splitVertex);
+                        DoSplit(map, &sectorsToUpdate, &journal, mapLine, splitVertex);
                     }
                     mapLine = NULL;
                 }
@@ -350,14 +709,14 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                     {
                         LogDebug("-> start at end point and end outside reverse");
                         line_t line1 = { mline.a, line.b };
-                        if(!Enqueue(&queue, line1, true)) return false;
+                        Enqueue(&queue, line1, true);
                         LogDebug("Add 1 %s(%s:%d)", __FUNCTION__, __FILE__, __LINE__);
                     }
                     else if(gt(u1, 0))
                     {
                         LogDebug("-> start at end point and end inside reverse");
                         MapVertex *splitVertex = EditAddVertex(map, intersection.p1);
-                        DoSplit(map, &sectorsToUpdate, mapLine, splitVertex);
+                        DoSplit(map, &sectorsToUpdate, &journal, mapLine, splitVertex);
                     }
                     mapLine = NULL;
                 }
@@ -367,14 +726,14 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                     {
                         LogDebug("-> start outside and end at endpoint reverse");
                         line_t line1 = { line.a, mline.b };
-                        if(!Enqueue(&queue, line1, true)) return false;
+                        Enqueue(&queue, line1, true);
                         LogDebug("Add 1 %s(%s:%d)", __FUNCTION__, __FILE__, __LINE__);
                     }
                     else if(lt(u0, 1))
                     {
                         LogDebug("-> start inside and end on endpoint reverse");
                         MapVertex *splitVertex = EditAddVertex(map, intersection.p0);
-                        DoSplit(map, &sectorsToUpdate, mapLine, splitVertex);
+                        DoSplit(map, &sectorsToUpdate, &journal, mapLine, splitVertex);
                     }
                     mapLine = NULL;
                 }
@@ -384,14 +743,14 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                     {
                         LogDebug("-> start outside and end at endpoint");
                         line_t line1 = { line.a, mline.a };
-                        if(!Enqueue(&queue, line1, true)) return false;
+                        Enqueue(&queue, line1, true);
                         LogDebug("Add 1 %s(%s:%d)", __FUNCTION__, __FILE__, __LINE__);
                     }
                     else if(gt(u0, 0))
                     {
                         LogDebug("-> start inside and end on endpoint");
                         MapVertex *splitVertex = EditAddVertex(map, intersection.p0);
-                        DoSplit(map, &sectorsToUpdate, mapLine, splitVertex);
+                        DoSplit(map, &sectorsToUpdate, &journal, mapLine, splitVertex);
                     }
                     mapLine = NULL;
                 }
@@ -400,16 +759,16 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                     LogDebug("-> start and end inside");
                     MapVertex *splitVertex1 = EditAddVertex(map, intersection.p0);
                     MapVertex *splitVertex2 = EditAddVertex(map, intersection.p1);
-                    DoSplit2(map, &sectorsToUpdate, mapLine, splitVertex1, splitVertex2);
+                    DoSplit2(map, &sectorsToUpdate, &journal, mapLine, splitVertex1, splitVertex2);
                     mapLine = NULL;
                 }
                 else if(lt(u0, 0) && lt(u1, 1)) // start outside and end inside
                 {
                     LogDebug("-> start outside and end inside");
                     MapVertex *splitVertex = EditAddVertex(map, intersection.p1);
-                    DoSplit(map, &sectorsToUpdate, mapLine, splitVertex);
+                    DoSplit(map, &sectorsToUpdate, &journal, mapLine, splitVertex);
                     line_t line1 = { line.a, mline.a };
-                    if(!Enqueue(&queue, line1, true)) return false;
+                    Enqueue(&queue, line1, true);
                     LogDebug("Add 1 %s(%s:%d)", __FUNCTION__, __FILE__, __LINE__);
                     mapLine = NULL;
                 }
@@ -417,9 +776,9 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                 {
                     LogDebug("-> start outside and end inside reverse");
                     MapVertex *splitVertex = EditAddVertex(map, intersection.p1);
-                    DoSplit(map, &sectorsToUpdate, mapLine, splitVertex);
+                    DoSplit(map, &sectorsToUpdate, &journal, mapLine, splitVertex);
                     line_t line1 = { line.a, mline.b };
-                    if(!Enqueue(&queue, line1, true)) return false;
+                    Enqueue(&queue, line1, true);
                     LogDebug("Add 1 %s:%d", __FILE__, __LINE__);
                     mapLine = NULL;
                 }
@@ -427,9 +786,9 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                 {
                     LogDebug("-> start inside and end outside");
                     MapVertex *splitVertex = EditAddVertex(map, intersection.p0);
-                    DoSplit(map, &sectorsToUpdate, mapLine, splitVertex);
+                    DoSplit(map, &sectorsToUpdate, &journal, mapLine, splitVertex);
                     line_t line1 = { mline.b, line.b };
-                    if(!Enqueue(&queue, line1, true)) return false;
+                    Enqueue(&queue, line1, true);
                     LogDebug("Add 1 %s(%s:%d)", __FUNCTION__, __FILE__, __LINE__);
                     mapLine = NULL;
                 }
@@ -437,9 +796,9 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                 {
                     LogDebug("-> start inside and end outside reverse");
                     MapVertex *splitVertex = EditAddVertex(map, intersection.p0);
-                    DoSplit(map, &sectorsToUpdate, mapLine, splitVertex);
+                    DoSplit(map, &sectorsToUpdate, &journal, mapLine, splitVertex);
                     line_t line1 = { mline.a, line.b };
-                    if(!Enqueue(&queue, line1, true)) return false;
+                    Enqueue(&queue, line1, true);
                     LogDebug("Add 1 %s(%s:%d)", __FUNCTION__, __FILE__, __LINE__);
                     mapLine = NULL;
                 }
@@ -459,8 +818,8 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                         line1 = (line_t){ line.a, mline.a };
                         line2 = (line_t){ mline.b, line.b };
                     }
-                    if(!Enqueue(&queue, line1, true)) return false;
-                    if(!Enqueue(&queue, line2, true)) return false;
+                    Enqueue(&queue, line1, true);
+                    Enqueue(&queue, line2, true);
                     LogDebug("Add 2 %s(%s:%d)", __FUNCTION__, __FILE__, __LINE__);
                     mapLine = NULL;
                 }
@@ -474,11 +833,9 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                     if(eq(v, 0.0) || eq(v, 1.0))
                     {
                         LogDebug("-> on each end");
-                        mapLine->mark = true;
-                        if(mapLine->frontSector)
-                            InsertSectorUpdate(&sectorsToUpdate, mapLine, mapLine->frontSector->data);
-                        if(mapLine->backSector)
-                            InsertSectorUpdate(&sectorsToUpdate, mapLine, mapLine->backSector->data);
+                        // the new line may cut the sectors around the line it touches
+                        InsertSectorUpdate(&sectorsToUpdate, mapLine->frontSector);
+                        InsertSectorUpdate(&sectorsToUpdate, mapLine->backSector);
                     }
                     else // if(v > 0 || v < 1)
                     {
@@ -486,9 +843,9 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                         line_t line1 = { .a = line.a, .b = intersection.p0 };
                         line_t line2 = { .a = intersection.p0, .b = line.b };
                         if(!eq(vec2_distance2(line1.a, line1.b), 0))
-                            if(!Enqueue(&queue, line1, true)) return false;
+                            Enqueue(&queue, line1, true);
                         if(!eq(vec2_distance2(line2.a, line2.b), 0))
-                            if(!Enqueue(&queue, line2, true)) return false;
+                            Enqueue(&queue, line2, true);
                         LogDebug("-> add line1 length: %f", vec2_distance(line1.b, line1.a));
                         LogDebug("-> add line2 length: %f", vec2_distance(line2.b, line2.a));
                         LogDebug("Add 2 %s(%s:%d)", __FUNCTION__, __FILE__, __LINE__);
@@ -504,8 +861,8 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                         if(!closestVert)
                         {
                             MapVertex *splitVertex = EditAddVertex(map, intersection.p0);
-                            DoSplit(map, &sectorsToUpdate, mapLine, splitVertex);
-                            if(!Enqueue(&queue, line, true)) return false;
+                            DoSplit(map, &sectorsToUpdate, &journal, mapLine, splitVertex);
+                            Enqueue(&queue, line, true);
                             LogDebug("Add 1 %s(%s:%d)", __FUNCTION__, __FILE__, __LINE__);
                         }
                         else
@@ -514,7 +871,7 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                                 line.b = closestVert->pos;
                             else
                                 line.a = closestVert->pos;
-                            if(!Enqueue(&queue, line, true)) return false;
+                            Enqueue(&queue, line, true);
                             LogDebug("Add 1 %s(%s:%d)", __FUNCTION__, __FILE__, __LINE__);
                         }
                         mapLine = NULL;
@@ -534,14 +891,14 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                         else
                         {
                             MapVertex *splitVertex = EditAddVertex(map, intersection.p0);
-                            DoSplit(map, &sectorsToUpdate, mapLine, splitVertex);
+                            DoSplit(map, &sectorsToUpdate, &journal, mapLine, splitVertex);
                         }
                         LogDebug("-> add line1 length: %f", mag(vec2_sub(line1.b, line1.a)));
                         LogDebug("-> add line2 length: %f", mag(vec2_sub(line2.b, line2.a)));
                         if(!eq(vec2_distance2(line1.a, line1.b), 0))
-                            if(!Enqueue(&queue, line1, true)) return false;
+                            Enqueue(&queue, line1, true);
                         if(!eq(vec2_distance2(line2.a, line2.b), 0))
-                            if(!Enqueue(&queue, line2, true)) return false;
+                            Enqueue(&queue, line2, true);
                         LogDebug("Add 2 %s(%s:%d)", __FUNCTION__, __FILE__, __LINE__);
                         mapLine = NULL;
                     }
@@ -552,9 +909,7 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
                 LogDebug("No Intersection or Overlap");
             }
 
-            if(mapLine)
-                mapLine = mapLine->next;
-            else
+            if(!mapLine)
                 canInsertLine = false;
         }
 
@@ -564,10 +919,20 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
             if(!mva) mva = EditAddVertex(map, line.a);
             MapVertex *mvb = FindClosestVertex(map, line.b, STITCHING_DIST);
             if(!mvb) mvb = EditAddVertex(map, line.b);
-            if(!mva || !mvb) return false;
+            if(!mva || !mvb)
+            {
+                ok = false;
+                break;
+            }
+            // a piece shorter than the stitching distance can snap both ends to one vertex
+            if(mva == mvb) continue;
 
             MapLine *newMapLine = EditAddLine(map, mva, mvb, DefaultLineData());
-            if(!newMapLine) return false;
+            if(!newMapLine)
+            {
+                ok = false;
+                break;
+            }
 
             numNewLines++;
             newMapLine->new = potentialStart;
@@ -576,22 +941,17 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
         didIntersect |= !canInsertLine;
     }
     LogDebug("Done inserting...");
+    arena_reset(&queueArena);
 
-    for(MapLine *line = map->headLine; line; line = line->next)
+    if(!ok)
     {
-        if(!line->mark) continue;
-        for(size_t i = 0; i < sectorsToUpdate.count; ++i)
-        {
-            if(line == sectorsToUpdate.items[i].line)
-            {
-                SectorData data = sectorsToUpdate.items[i].sectorData;
-                MakeMapSector(map, line, data);
-            }
-        }
-        line->mark = false;
+        rollbackInsert(map, &journal);
+        arena_reset(&sectorUpdateArena);
+        return false;
     }
+    commitInsert(map, &journal);
 
-    arena_reset(&sectorUpdateArena);
+    RebuildSectors(map, &sectorsToUpdate);
 
     // create sectors from the new lines
     if(isLoop)
@@ -616,3 +976,353 @@ bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts
 
     return true;
 }
+
+typedef struct SegmentSplit
+{
+    size_t segment;
+    real_t t;
+    Vec2 p;
+} SegmentSplit;
+
+typedef struct SegmentSplits
+{
+    SegmentSplit *items;
+    size_t count, capacity;
+} SegmentSplits;
+
+typedef struct BulkSegment
+{
+    line_t line;
+    MapLine *mapLine; // NULL for the segments being inserted
+
+    MapVertex **chain;
+    size_t chainLength;
+} BulkSegment;
+
+typedef struct BulkInsert
+{
+    BulkSegment *segments;
+    size_t numSegments, numNew;
+    SegmentSplits splits;
+    // the map lines that get split
+    BulkSegment **splitLines;
+    size_t numSplitLines;
+} BulkInsert;
+
+static Arena bulkArena = { 0 };
+
+static inline void addSplit(BulkInsert *bulk, size_t segment, real_t t, Vec2 p)
+{
+    // the ends are not splits
+    if(t <= EPSILON || t >= 1 - EPSILON) return;
+    arena_da_append(&bulkArena, &bulk->splits, ((SegmentSplit){ .segment = segment, .t = t, .p = p }));
+}
+
+static void intersectPair(size_t a, size_t b, void *user)
+{
+    BulkInsert *bulk = user;
+    const BulkSegment *sa = &bulk->segments[a], *sb = &bulk->segments[b];
+    // the lines of the map never cross each other
+    if(sa->mapLine && sb->mapLine) return;
+
+    intersection_res_t res = { 0 };
+    if(LineOverlap(sa->line, sb->line, &res))
+    {
+        // each segment is split at the ends of the other one that lie inside it
+        addSplit(bulk, a, res.u, res.p0);
+        addSplit(bulk, a, res.v, res.p1);
+        if(LineOverlap(sb->line, sa->line, &res))
+        {
+            addSplit(bulk, b, res.u, res.p0);
+            addSplit(bulk, b, res.v, res.p1);
+        }
+    }
+    else if(LineIntersection(sa->line, sb->line, &res))
+    {
+        addSplit(bulk, a, res.u, res.p0);
+        addSplit(bulk, b, res.v, res.p0);
+    }
+}
+
+static int compareSplits(const void *a, const void *b)
+{
+    const SegmentSplit *sa = a, *sb = b;
+    if(sa->segment != sb->segment) return (sa->segment > sb->segment) - (sa->segment < sb->segment);
+    return (sa->t > sb->t) - (sa->t < sb->t);
+}
+
+static void addExistingLine(void *element, void *user)
+{
+    MapLine *line = element;
+    // queried once per new segment, only take each line the first time
+    if(line->mark) return;
+    line->mark = true;
+    arena_da_append(&bulkArena, (LineCandidates*)user, line);
+}
+
+static inline MapVertex* vertexAt(Map *map, Vec2 pos)
+{
+    MapVertex *vertex = FindClosestVertex(map, pos, STITCHING_DIST);
+    return vertex ? vertex : EditAddVertex(map, pos);
+}
+
+// true if the loop in front of line encloses a face, the outside of a group of lines is traced the other way around
+static bool boundsFace(MapLine *line)
+{
+    MapLine *loop[MAX_LINES_PER_SECTOR];
+    size_t numLines = FindOuterLineLoop(line, loop, MAX_LINES_PER_SECTOR);
+    if(numLines < 3) return false;
+    struct Polygon *poly = PolygonFromMapLines(numLines, loop);
+    bool bounded = LineLoopOrientation(poly->length, (Vec2*)poly->vertices) == CW_ORIENT;
+    free(poly);
+    return bounded;
+}
+
+static MapLine* reverseLine(Map *map, MapLine *line)
+{
+    MapVertex *va = line->a, *vb = line->b;
+    LineData data = CopyLineData(line->data);
+    RemoveLine(map, line);
+    MapLine *reversed = EditAddLine(map, vb, va, data);
+    FreeLineData(data);
+    return reversed;
+}
+
+typedef struct PassLines
+{
+    size_t *items;
+    size_t count, capacity;
+} PassLines;
+
+static void addNearLine(void *element, void *user)
+{
+    arena_da_append(&bulkArena, (LineCandidates*)user, (MapLine*)element);
+}
+
+// the pieces keep whether they belong to an inserted segment and go back on the list to be checked again
+static void splitCrossing(Map *map, SectorUpdate *sectorUpdate, PassLines *passLines, MapLine *line, MapVertex *vertex)
+{
+    const bool inserted = line->mark, isNew = line->new;
+    SplitResult result = DoSplit(map, sectorUpdate, NULL, line, vertex);
+    MapLine *pieces[] = { result.left, result.right };
+    for(size_t i = 0; i < COUNT_OF(pieces); ++i)
+    {
+        if(!pieces[i]) continue;
+        pieces[i]->mark = inserted;
+        pieces[i]->new = isNew;
+        arena_da_append(&bulkArena, passLines, pieces[i]->idx);
+    }
+}
+
+// snapping a split to a vertex nearby bends the pieces through it, a bent piece can cross a line next to it
+static void splitCrossings(Map *map, SectorUpdate *sectorUpdate, PassLines *passLines)
+{
+    for(size_t i = 0; i < passLines->count; ++i)
+    {
+        MapLine *line = GetLine(map, passLines->items[i]);
+        if(!line) continue;
+
+        const line_t segment = { .a = line->a->pos, .b = line->b->pos };
+        LineCandidates near = { 0 };
+        LineGridQueryBox(&map->lineGrid, SegmentBox(segment), addNearLine, &near);
+        for(size_t j = 0; j < near.count; ++j)
+        {
+            MapLine *other = near.items[j];
+            if(other->a == line->a || other->a == line->b || other->b == line->a || other->b == line->b)
+                continue;
+
+            intersection_res_t res = { 0 };
+            if(!LineIntersection(segment, (line_t){ .a = other->a->pos, .b = other->b->pos }, &res))
+                continue;
+
+            // a line ending on the other one splits it at its end vertex
+            const bool insideLine = res.u > EPSILON && res.u < 1 - EPSILON;
+            const bool insideOther = res.v > EPSILON && res.v < 1 - EPSILON;
+            if(!insideLine && !insideOther) continue;
+
+            MapVertex *vertex;
+            if(!insideOther)
+                vertex = res.v < 0.5 ? other->a : other->b;
+            else if(!insideLine)
+                vertex = res.u < 0.5 ? line->a : line->b;
+            else
+                vertex = EditAddVertex(map, res.p0);
+
+            if(insideOther) splitCrossing(map, sectorUpdate, passLines, other, vertex);
+            // the pieces of a split line go back on the list, an intact line keeps looking for crossings
+            if(insideLine)
+            {
+                splitCrossing(map, sectorUpdate, passLines, line, vertex);
+                break;
+            }
+        }
+    }
+}
+
+bool InsertSegmentsIntoMap(Map *map, size_t numSegments, line_t segments[static numSegments], bool makeSectors)
+{
+    BulkInsert bulk = { 0 };
+
+    // snap the ends onto existing vertices first so the intersections are found on the final geometry
+    LineCandidates lines = { 0 };
+    for(size_t i = 0; i < numSegments; ++i)
+    {
+        line_t *segment = &segments[i];
+        MapVertex *va = FindClosestVertex(map, segment->a, STITCHING_DIST);
+        if(va) segment->a = va->pos;
+        MapVertex *vb = FindClosestVertex(map, segment->b, STITCHING_DIST);
+        if(vb) segment->b = vb->pos;
+
+        LineGridQueryBox(&map->lineGrid, SegmentBox(*segment), addExistingLine, &lines);
+    }
+
+    // new segments first, then the map lines they may touch
+    bulk.numNew = numSegments;
+    bulk.numSegments = numSegments + lines.count;
+    bulk.segments = arena_alloc(&bulkArena, bulk.numSegments * sizeof *bulk.segments);
+    BoundingBox *boxes = arena_alloc(&bulkArena, bulk.numSegments * sizeof *boxes);
+    for(size_t i = 0; i < bulk.numSegments; ++i)
+    {
+        BulkSegment *segment = &bulk.segments[i];
+        *segment = (BulkSegment){ 0 };
+        if(i < numSegments)
+        {
+            segment->line = segments[i];
+        }
+        else
+        {
+            segment->mapLine = lines.items[i - numSegments];
+            segment->mapLine->mark = false;
+            segment->line = (line_t){ .a = segment->mapLine->a->pos, .b = segment->mapLine->b->pos };
+        }
+        boxes[i] = SegmentBox(segment->line);
+    }
+
+    SweepOverlappingPairs(bulk.numSegments, boxes, intersectPair, &bulk);
+    if(bulk.splits.count > 1)
+        qsort(bulk.splits.items, bulk.splits.count, sizeof *bulk.splits.items, compareSplits);
+    LogDebug("Bulk insert: %zu segments, %zu map lines, %zu splits", numSegments, lines.count, bulk.splits.count);
+
+    // turn every segment into a chain of vertices, creating the vertices at the splits
+    size_t split = 0;
+    for(size_t i = 0; i < bulk.numSegments; ++i)
+    {
+        BulkSegment *segment = &bulk.segments[i];
+        size_t end = split;
+        while(end < bulk.splits.count && bulk.splits.items[end].segment == i) end++;
+
+        MapVertex *first = segment->mapLine ? segment->mapLine->a : vertexAt(map, segment->line.a);
+        MapVertex *last = segment->mapLine ? segment->mapLine->b : vertexAt(map, segment->line.b);
+        segment->chain = arena_alloc(&bulkArena, (end - split + 2) * sizeof *segment->chain);
+        segment->chain[segment->chainLength++] = first;
+        for(; split < end; ++split)
+        {
+            MapVertex *vertex = vertexAt(map, bulk.splits.items[split].p);
+            // a split snapped to an existing vertex still splits map lines there, the crossing segment is routed through the same vertex
+            if(vertex == first || vertex == last || vertex == segment->chain[segment->chainLength-1])
+                continue;
+            segment->chain[segment->chainLength++] = vertex;
+        }
+        if(last != first)
+            segment->chain[segment->chainLength++] = last;
+    }
+
+    bulk.splitLines = arena_alloc(&bulkArena, (bulk.numSegments - bulk.numNew + 1) * sizeof *bulk.splitLines);
+    for(size_t i = bulk.numNew; i < bulk.numSegments; ++i)
+    {
+        if(bulk.segments[i].chainLength > 2)
+            bulk.splitLines[bulk.numSplitLines++] = &bulk.segments[i];
+    }
+
+    // the sectors around a split line take its pieces in its place, they are checked against their faces at the end
+    SectorUpdate sectorsToUpdate = { 0 };
+    // every line this pass creates, by idx as splitting them again replaces them
+    PassLines passLines = { 0 };
+    for(size_t i = 0; i < bulk.numSplitLines; ++i)
+    {
+        BulkSegment *segment = bulk.splitLines[i];
+        SplitSide front = splitSide(segment->mapLine->frontSector, segment->mapLine);
+        SplitSide back = splitSide(segment->mapLine->backSector, segment->mapLine);
+
+        LineData data = CopyLineData(segment->mapLine->data);
+        RemoveLine(map, segment->mapLine);
+        segment->mapLine = NULL;
+        MapLine **pieces = arena_alloc(&bulkArena, segment->chainLength * sizeof *pieces);
+        size_t numPieces = 0;
+        for(size_t c = 0; c + 1 < segment->chainLength; ++c)
+        {
+            MapLine *piece = EditAddLine(map, segment->chain[c], segment->chain[c+1], data);
+            if(!piece) continue;
+            pieces[numPieces++] = piece;
+            arena_da_append(&bulkArena, &passLines, piece->idx);
+        }
+        FreeLineData(data);
+
+        patchSplitSide(map, &sectorsToUpdate, front, true, numPieces, pieces);
+        patchSplitSide(map, &sectorsToUpdate, back, false, numPieces, pieces);
+    }
+
+    bulk.numSplitLines = 0;
+
+    bool ok = true;
+    for(size_t i = 0; i < bulk.numNew; ++i)
+    {
+        const BulkSegment *segment = &bulk.segments[i];
+        for(size_t c = 0; c + 1 < segment->chainLength; ++c)
+        {
+            const size_t numLines = map->numLines;
+            MapLine *line = EditAddLine(map, segment->chain[c], segment->chain[c+1], DefaultLineData());
+            if(!line)
+            {
+                ok = false;
+                continue;
+            }
+            if(map->numLines > numLines)
+            {
+                // marks the lines of the inserted segments until the pass is done
+                line->mark = true;
+                line->new = makeSectors;
+                arena_da_append(&bulkArena, &passLines, line->idx);
+            }
+        }
+    }
+
+    splitCrossings(map, &sectorsToUpdate, &passLines);
+
+    // a new line connecting existing geometry through a sector cuts it, without splitting any of its lines
+    for(size_t i = 0; i < passLines.count; ++i)
+    {
+        MapLine *line = GetLine(map, passLines.items[i]);
+        if(!line || !line->mark) continue;
+        line->mark = false;
+        if(line->a->numAttachedLines < 2 || line->b->numAttachedLines < 2)
+            continue;
+        Vec2 middle = vec2_scale(vec2_add(line->a->pos, line->b->pos), 0.5f);
+        InsertSectorUpdate(&sectorsToUpdate, SectorTreePick(&map->sectorTree, middle));
+    }
+
+    arena_reset(&bulkArena);
+
+    RebuildSectors(map, &sectorsToUpdate);
+
+    if(makeSectors)
+    {
+        for(MapLine *line = map->headLine, *next; line; line = next)
+        {
+            next = line->next;
+            if(!line->new) continue;
+            line->new = false;
+            if(line->frontSector) continue;
+            if(!boundsFace(line))
+            {
+                // the segments can come in either direction, try the face behind the line
+                if(line->backSector) continue;
+                line = reverseLine(map, line);
+                if(!boundsFace(line)) continue;
+            }
+            MakeMapSector(map, line, DefaultSectorData());
+        }
+    }
+
+    return ok;
+}
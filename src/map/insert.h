@@ -1,7 +1,15 @@
 #pragma once
 
 #include "../map.h"
+#include "../geometry.h"
 #include "../vecmath.h"
 
 MapSector* MakeMapSector(Map *map, MapLine *startLine, SectorData data);
-bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts], bool isLoop);
+// called before each queued segment is processed, returning false cancels the insert
+// a cancelled or failed insert is rolled back, the map is left as it was before the call
+typedef bool (*InsertProgressFn)(size_t processed, size_t pending, void *user);
+
+// progress may be NULL
+bool InsertLinesIntoMap(Map *map, size_t numVerts, Vec2 vertices[static numVerts], bool isLoop, InsertProgressFn progress, void *user);
+// inserts all segments in one pass, every intersection is found up front and each line is split once
+bool InsertSegmentsIntoMap(Map *map, size_t numSegments, line_t segments[static numSegments], bool makeSectors);
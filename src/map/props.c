@@ -0,0 +1,126 @@
+#include "props.h"
+
+#include <string.h>
+
+#define PROPERTY_MIN_CAPACITY 2
+
+// index of the first item with a key not below the given one
+static uint32_t lowerBound(const PropertyTable *props, StringId key)
+{
+    uint32_t lo = 0, hi = props->count;
+    while(lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if(props->items[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+const Property* PropertyGet(const PropertyTable *props, const char *key)
+{
+    StringId id = FindInternedString(key);
+    if(id == 0) return NULL;
+
+    uint32_t i = lowerBound(props, id);
+    if(i < props->count && props->items[i].key == id)
+        return &props->items[i];
+    return NULL;
+}
+
+// a string value has its own block in the element heap, so it can be given back when the value changes
+static void freeValue(Map *map, Property *prop)
+{
+    if(prop->type == PROPERTY_STRING)
+        BlockFree(&map->elementHeap, (char*)prop->string);
+    prop->string = NULL;
+}
+
+static Property* findOrInsert(Map *map, PropertyTable *props, const char *key)
+{
+    StringId id = InternString(key);
+    uint32_t i = lowerBound(props, id);
+    if(i < props->count && props->items[i].key == id)
+        return &props->items[i];
+
+    if(props->count == props->capacity)
+    {
+        uint32_t newCapacity = props->capacity == 0 ? PROPERTY_MIN_CAPACITY : props->capacity * 2;
+        props->items = BlockRealloc(&map->elementHeap, props->items, newCapacity * sizeof *props->items);
+        props->capacity = newCapacity;
+    }
+
+    memmove(&props->items[i + 1], &props->items[i], (props->count - i) * sizeof *props->items);
+    props->count++;
+    props->items[i] = (Property){ .key = id };
+    return &props->items[i];
+}
+
+void PropertySetString(Map *map, PropertyTable *props, const char *key, const char *value)
+{
+    Property *prop = findOrInsert(map, props, key);
+    if(!value)
+    {
+        freeValue(map, prop);
+        prop->type = PROPERTY_STRING;
+        return;
+    }
+    if(prop->type == PROPERTY_STRING && prop->string && strcmp(prop->string, value) == 0)
+        return;
+
+    // the old block is reused when the new value fits into it
+    const size_t size = strlen(value) + 1;
+    char *string = BlockRealloc(&map->elementHeap, prop->type == PROPERTY_STRING ? (char*)prop->string : NULL, size);
+    memcpy(string, value, size);
+    prop->type = PROPERTY_STRING;
+    prop->string = string;
+}
+
+void PropertySetBool(Map *map, PropertyTable *props, const char *key, bool value)
+{
+    Property *prop = findOrInsert(map, props, key);
+    freeValue(map, prop);
+    prop->type = PROPERTY_BOOL;
+    prop->boolean = value;
+}
+
+void PropertySetNumber(Map *map, PropertyTable *props, const char *key, double value)
+{
+    Property *prop = findOrInsert(map, props, key);
+    freeValue(map, prop);
+    prop->type = PROPERTY_NUMBER;
+    prop->number = value;
+}
+
+void PropertySetEnum(Map *map, PropertyTable *props, const char *key, const char *value)
+{
+    Property *prop = findOrInsert(map, props, key);
+    freeValue(map, prop);
+    prop->type = PROPERTY_ENUM;
+    prop->enumValue = InternString(value);
+}
+
+bool PropertyRemove(Map *map, PropertyTable *props, const char *key)
+{
+    StringId id = FindInternedString(key);
+    if(id == 0) return false;
+
+    uint32_t i = lowerBound(props, id);
+    if(i >= props->count || props->items[i].key != id)
+        return false;
+
+    freeValue(map, &props->items[i]);
+    memmove(&props->items[i], &props->items[i + 1], (props->count - i - 1) * sizeof *props->items);
+    props->count--;
+    return true;
+}
+
+void FreeProperties(Map *map, PropertyTable *props)
+{
+    for(uint32_t i = 0; i < props->count; ++i)
+        freeValue(map, &props->items[i]);
+    BlockFree(&map->elementHeap, props->items);
+    *props = (PropertyTable){ 0 };
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "../map.h"
+
+const Property* PropertyGet(const PropertyTable *props, const char *key);
+void PropertySetString(Map *map, PropertyTable *props, const char *key, const char *value);
+void PropertySetBool(Map *map, PropertyTable *props, const char *key, bool value);
+void PropertySetNumber(Map *map, PropertyTable *props, const char *key, double value);
+void PropertySetEnum(Map *map, PropertyTable *props, const char *key, const char *value);
+bool PropertyRemove(Map *map, PropertyTable *props, const char *key);
+// gives the items and string values back to the element heap, for an element that is removed
+void FreeProperties(Map *map, PropertyTable *props);
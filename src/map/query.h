@@ -9,9 +9,6 @@ MapSector* FindEquivalentSector(Map *map, size_t numLines, MapLine *lines[static
 
 MapVertex* FindClosestVertex(const Map *map, Vec2 position, float radiusSq);
 
-int angleSortOuter(const void *a, const void *b);
-int angleSortInner(const void *a, const void *b);
-
-size_t FindLineLoop(MapLine *startLine, MapLine **loop, size_t maxLoopLength, int(*cmpFunc)(const void*, const void*));
-#define FindOuterLineLoop(startLine, loop, maxLoopLength) FindLineLoop(startLine, loop, maxLoopLength, angleSortOuter)
-#define FindInnerLineLoop(startLine, loop, maxLoopLength) FindLineLoop(startLine, loop, maxLoopLength, angleSortInner)
+// both walk from startLine->a to startLine->b, outer takes the sharpest turn at each vertex, inner the widest
+size_t FindOuterLineLoop(MapLine *startLine, MapLine **loop, size_t maxLoopLength);
+size_t FindInnerLineLoop(MapLine *startLine, MapLine **loop, size_t maxLoopLength);
@@ -1,4 +1,8 @@
 #include "remove.h"
+#include "grid.h"
+#include "hot.h"
+#include "index.h"
+#include "tree.h"
 
 #include <string.h>
 
@@ -30,6 +34,8 @@ void RemoveVertex(Map *map, MapVertex *vertex)
     for(size_t i = 0; i < vertex->numAttachedLines; ++i)
     {
         MapLine *line = vertex->attachedLines[i];
+        // the line is keyed by its endpoints, so it has to leave the table before one of them is cleared
+        LineTableRemove(&map->lineTable, line);
         if(line->a == vertex)
         {
             line->a = NULL;
@@ -40,7 +46,11 @@ void RemoveVertex(Map *map, MapVertex *vertex)
         }
     }
 
-    FreeMapVertex(vertex);
+    IndexUnset(&map->vertexIndex, vertex->idx, vertex);
+    VertexGridRemove(&map->vertexGrid, vertex);
+    HotRemoveVertex(&map->hot, vertex);
+    FreeMapVertex(map, vertex);
+    PoolFree(&map->vertexPool, vertex);
 
     map->numVertices--;
     map->dirty = true;
@@ -79,7 +89,7 @@ void RemoveLine(Map *map, MapLine *line)
             MapLine *attLine = v->attachedLines[i];
             attLine->a == v ? attLine->aVertIndex-- : attLine->bVertIndex--;
         }
-        memmove(v->attachedLines + line->aVertIndex, v->attachedLines + line->aVertIndex + 1, (v->numAttachedLines - (line->aVertIndex)) * sizeof *v->attachedLines);
+        memmove(v->attachedLines + line->aVertIndex, v->attachedLines + line->aVertIndex + 1, (v->numAttachedLines - (line->aVertIndex + 1)) * sizeof *v->attachedLines);
         v->numAttachedLines--;
     }
 
@@ -91,11 +101,17 @@ void RemoveLine(Map *map, MapLine *line)
             MapLine *attLine = v->attachedLines[i];
             attLine->a == v ? attLine->aVertIndex-- : attLine->bVertIndex--;
         }
-        memmove(v->attachedLines + line->bVertIndex, v->attachedLines + line->bVertIndex + 1, (v->numAttachedLines - (line->bVertIndex)) * sizeof *v->attachedLines);
+        memmove(v->attachedLines + line->bVertIndex, v->attachedLines + line->bVertIndex + 1, (v->numAttachedLines - (line->bVertIndex + 1)) * sizeof *v->attachedLines);
         v->numAttachedLines--;
     }
 
-    FreeMapLine(line);
+    IndexUnset(&map->lineIndex, line->idx, line);
+    LineTableRemove(&map->lineTable, line);
+    // the hot arrays still hold the line's original endpoints if a vertex was removed first
+    LineGridRemove(&map->lineGrid, line, map->hot.lineA[line->slot], map->hot.lineB[line->slot]);
+    HotRemoveLine(&map->hot, line);
+    FreeMapLine(map, line);
+    PoolFree(&map->linePool, line);
 
     map->numLines--;
     map->dirty = true;
@@ -143,7 +159,12 @@ void RemoveSector(Map *map, MapSector *sector)
         }
     }
 
-    FreeMapSector(sector);
+    IndexUnset(&map->sectorIndex, sector->idx, sector);
+    SectorTableRemove(&map->sectorTable, sector);
+    SectorTreeRemove(&map->sectorTree, sector);
+    HotRemoveSector(&map->hot, sector);
+    FreeMapSector(map, sector);
+    PoolFree(&map->sectorPool, sector);
 
     map->numSectors--;
     map->dirty = true;
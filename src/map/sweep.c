@@ -0,0 +1,115 @@
+#include "sweep.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+typedef struct SweepEvent
+{
+    real_t x;
+    // boxes enter before others leave at the same x, touching boxes overlap
+    bool leave;
+    size_t box;
+} SweepEvent;
+
+// the active boxes ordered by min y, a max tree over their max y prunes the ones that end below a query
+typedef struct ActiveSet
+{
+    const BoundingBox *boxes;
+    size_t *order, *position;
+    real_t *maxY;
+    size_t size;
+} ActiveSet;
+
+static int compareEvents(const void *a, const void *b)
+{
+    const SweepEvent *ea = a, *eb = b;
+    if(ea->x < eb->x) return -1;
+    if(ea->x > eb->x) return 1;
+    if(ea->leave != eb->leave) return ea->leave ? 1 : -1;
+    return (ea->box > eb->box) - (ea->box < eb->box);
+}
+
+static void setActive(ActiveSet *set, size_t box, bool active)
+{
+    size_t node = set->size + set->position[box];
+    set->maxY[node] = active ? set->boxes[box].max.y : -INFINITY;
+    for(node /= 2; node > 0; node /= 2)
+        set->maxY[node] = fmax(set->maxY[2 * node], set->maxY[2 * node + 1]);
+}
+
+// reports the active boxes among the first limit positions that reach up to minY
+static void queryActive(const ActiveSet *set, size_t node, size_t first, size_t count, size_t limit, real_t minY, size_t box, SweepPairFn fn, void *user)
+{
+    if(first >= limit || set->maxY[node] < minY) return;
+
+    if(count == 1)
+    {
+        fn(set->order[first], box, user);
+        return;
+    }
+
+    const size_t half = count / 2;
+    queryActive(set, 2 * node, first, half, limit, minY, box, fn, user);
+    queryActive(set, 2 * node + 1, first + half, half, limit, minY, box, fn, user);
+}
+
+void SweepOverlappingPairs(size_t num, const BoundingBox boxes[static num], SweepPairFn fn, void *user)
+{
+    if(num < 2) return;
+
+    SweepEvent *events = malloc(2 * num * sizeof *events);
+    for(size_t i = 0; i < num; ++i)
+    {
+        events[2 * i] = (SweepEvent){ .x = boxes[i].min.x, .box = i };
+        events[2 * i + 1] = (SweepEvent){ .x = boxes[i].max.x, .leave = true, .box = i };
+    }
+    qsort(events, 2 * num, sizeof *events, compareEvents);
+
+    ActiveSet set = { .boxes = boxes, .size = 1 };
+    while(set.size < num) set.size *= 2;
+    set.order = malloc(num * sizeof *set.order);
+    set.position = malloc(num * sizeof *set.position);
+    set.maxY = malloc(2 * set.size * sizeof *set.maxY);
+    // the leaves of the max tree are the boxes in min y order
+    SweepEvent *byY = malloc(num * sizeof *byY);
+    for(size_t i = 0; i < num; ++i)
+        byY[i] = (SweepEvent){ .x = boxes[i].min.y, .box = i };
+    qsort(byY, num, sizeof *byY, compareEvents);
+    for(size_t i = 0; i < num; ++i)
+    {
+        set.order[i] = byY[i].box;
+        set.position[byY[i].box] = i;
+    }
+    free(byY);
+    for(size_t i = 0; i < 2 * set.size; ++i)
+        set.maxY[i] = -INFINITY;
+
+    for(size_t e = 0; e < 2 * num; ++e)
+    {
+        const size_t b = events[e].box;
+        if(events[e].leave)
+        {
+            setActive(&set, b, false);
+            continue;
+        }
+
+        // only boxes starting at or below the new box's max y can overlap it
+        size_t lo = 0, hi = num;
+        while(lo < hi)
+        {
+            size_t mid = (lo + hi) / 2;
+            if(boxes[set.order[mid]].min.y <= boxes[b].max.y)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        queryActive(&set, 1, 0, set.size, lo, boxes[b].min.y, b, fn, user);
+        setActive(&set, b, true);
+    }
+
+    free(set.maxY);
+    free(set.position);
+    free(set.order);
+    free(events);
+}
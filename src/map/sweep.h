@@ -0,0 +1,8 @@
+#pragma once
+
+#include "../map.h"
+
+typedef void (*SweepPairFn)(size_t a, size_t b, void *user);
+
+// calls fn once for every pair of overlapping boxes, a is always the box that entered the sweep first
+void SweepOverlappingPairs(size_t num, const BoundingBox boxes[static num], SweepPairFn fn, void *user);
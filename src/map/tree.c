@@ -0,0 +1,276 @@
+#include "tree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../geometry.h"
+
+#define TREE_NULL 0
+#define TREE_MIN_CAPACITY 256
+#define TREE_STACK_SIZE 256
+
+static inline BoundingBox unionBB(BoundingBox a, BoundingBox b)
+{
+    return (BoundingBox){
+        .min = { .x = a.min.x < b.min.x ? a.min.x : b.min.x, .y = a.min.y < b.min.y ? a.min.y : b.min.y },
+        .max = { .x = a.max.x > b.max.x ? a.max.x : b.max.x, .y = a.max.y > b.max.y ? a.max.y : b.max.y }
+    };
+}
+
+static inline real_t area(BoundingBox bb)
+{
+    return (bb.max.x - bb.min.x) * (bb.max.y - bb.min.y);
+}
+
+static inline bool containsPoint(BoundingBox bb, Vec2 p)
+{
+    return p.x >= bb.min.x && p.x <= bb.max.x && p.y >= bb.min.y && p.y <= bb.max.y;
+}
+
+static inline bool overlaps(BoundingBox a, BoundingBox b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y;
+}
+
+static uint32_t allocNode(SectorTree *tree)
+{
+    if(tree->freeList != TREE_NULL)
+    {
+        uint32_t node = tree->freeList;
+        tree->freeList = tree->nodes[node].parent;
+        tree->nodes[node] = (SectorTreeNode){ 0 };
+        return node;
+    }
+
+    if(tree->numNodes == tree->capacity)
+    {
+        tree->capacity = tree->capacity == 0 ? TREE_MIN_CAPACITY : tree->capacity * 2;
+        tree->nodes = realloc(tree->nodes, tree->capacity * sizeof *tree->nodes);
+        if(tree->numNodes == 0)
+            tree->numNodes = 1;
+    }
+
+    uint32_t node = tree->numNodes++;
+    tree->nodes[node] = (SectorTreeNode){ 0 };
+    return node;
+}
+
+static void freeNode(SectorTree *tree, uint32_t node)
+{
+    tree->nodes[node].parent = tree->freeList;
+    tree->nodes[node].sector = NULL;
+    tree->freeList = node;
+}
+
+// recomputes the boxes from node up to the root
+static void refit(SectorTree *tree, uint32_t node)
+{
+    SectorTreeNode *nodes = tree->nodes;
+    while(node != TREE_NULL)
+    {
+        nodes[node].bb = unionBB(nodes[nodes[node].left].bb, nodes[nodes[node].right].bb);
+        node = nodes[node].parent;
+    }
+}
+
+static void insertLeaf(SectorTree *tree, uint32_t leaf)
+{
+    if(tree->root == TREE_NULL)
+    {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = TREE_NULL;
+        return;
+    }
+
+    // descend towards the child whose box grows the least
+    SectorTreeNode *nodes = tree->nodes;
+    BoundingBox bb = nodes[leaf].bb;
+    uint32_t sibling = tree->root;
+    while(nodes[sibling].sector == NULL)
+    {
+        uint32_t left = nodes[sibling].left, right = nodes[sibling].right;
+        real_t combined = area(unionBB(nodes[sibling].bb, bb));
+        real_t cost = 2 * combined;
+        real_t inherited = 2 * (combined - area(nodes[sibling].bb));
+        real_t costLeft = area(unionBB(nodes[left].bb, bb)) + inherited;
+        real_t costRight = area(unionBB(nodes[right].bb, bb)) + inherited;
+        if(nodes[left].sector == NULL) costLeft -= area(nodes[left].bb);
+        if(nodes[right].sector == NULL) costRight -= area(nodes[right].bb);
+
+        if(cost < costLeft && cost < costRight)
+            break;
+        sibling = costLeft < costRight ? left : right;
+    }
+
+    uint32_t oldParent = nodes[sibling].parent;
+    uint32_t newParent = allocNode(tree);
+    nodes = tree->nodes;
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if(oldParent == TREE_NULL)
+        tree->root = newParent;
+    else if(nodes[oldParent].left == sibling)
+        nodes[oldParent].left = newParent;
+    else
+        nodes[oldParent].right = newParent;
+
+    refit(tree, newParent);
+}
+
+static void removeLeaf(SectorTree *tree, uint32_t leaf)
+{
+    SectorTreeNode *nodes = tree->nodes;
+    if(leaf == tree->root)
+    {
+        tree->root = TREE_NULL;
+        return;
+    }
+
+    // the sibling takes the place of the parent
+    uint32_t parent = nodes[leaf].parent;
+    uint32_t grandParent = nodes[parent].parent;
+    uint32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    if(grandParent == TREE_NULL)
+    {
+        tree->root = sibling;
+        nodes[sibling].parent = TREE_NULL;
+    }
+    else
+    {
+        if(nodes[grandParent].left == parent)
+            nodes[grandParent].left = sibling;
+        else
+            nodes[grandParent].right = sibling;
+        nodes[sibling].parent = grandParent;
+        refit(tree, grandParent);
+    }
+    freeNode(tree, parent);
+}
+
+void SectorTreeUpdate(SectorTree *tree, MapSector *sector)
+{
+    if(sector->treeLeaf != TREE_NULL)
+        removeLeaf(tree, sector->treeLeaf);
+    else
+        sector->treeLeaf = allocNode(tree);
+
+    tree->nodes[sector->treeLeaf].bb = sector->bb;
+    tree->nodes[sector->treeLeaf].sector = sector;
+    tree->nodes[sector->treeLeaf].left = tree->nodes[sector->treeLeaf].right = TREE_NULL;
+    insertLeaf(tree, sector->treeLeaf);
+}
+
+void SectorTreeRemove(SectorTree *tree, MapSector *sector)
+{
+    if(sector->treeLeaf == TREE_NULL) return;
+
+    removeLeaf(tree, sector->treeLeaf);
+    freeNode(tree, sector->treeLeaf);
+    sector->treeLeaf = TREE_NULL;
+}
+
+// traversal stack that starts out on the C stack, without rebalancing the tree can get deeper than that
+typedef struct NodeStack
+{
+    uint32_t *items;
+    size_t top, capacity;
+    uint32_t buffer[TREE_STACK_SIZE];
+} NodeStack;
+
+static void stackPush(NodeStack *stack, uint32_t node)
+{
+    if(stack->top == stack->capacity)
+    {
+        stack->capacity *= 2;
+        if(stack->items == stack->buffer)
+        {
+            stack->items = malloc(stack->capacity * sizeof *stack->items);
+            memcpy(stack->items, stack->buffer, sizeof stack->buffer);
+        }
+        else
+        {
+            stack->items = realloc(stack->items, stack->capacity * sizeof *stack->items);
+        }
+    }
+    stack->items[stack->top++] = node;
+}
+
+static void stackFree(NodeStack *stack)
+{
+    if(stack->items != stack->buffer)
+        free(stack->items);
+}
+
+MapSector* SectorTreePick(const SectorTree *tree, Vec2 pos)
+{
+    if(tree->root == TREE_NULL) return NULL;
+
+    MapSector *best = NULL;
+    real_t bestArea = 0;
+
+    NodeStack stack = { .capacity = TREE_STACK_SIZE };
+    stack.items = stack.buffer;
+    stackPush(&stack, tree->root);
+    while(stack.top > 0)
+    {
+        const SectorTreeNode *node = &tree->nodes[stack.items[--stack.top]];
+        if(!containsPoint(node->bb, pos))
+            continue;
+
+        if(node->sector)
+        {
+            real_t a = area(node->bb);
+            if(best && (a > bestArea || (a == bestArea && node->sector->idx > best->idx)))
+                continue;
+            if(PointInSector2(node->sector, pos))
+            {
+                best = node->sector;
+                bestArea = a;
+            }
+            continue;
+        }
+
+        stackPush(&stack, node->left);
+        stackPush(&stack, node->right);
+    }
+
+    stackFree(&stack);
+    return best;
+}
+
+void SectorTreeQueryBox(const SectorTree *tree, BoundingBox box, MapVisitFn fn, void *user)
+{
+    if(tree->root == TREE_NULL) return;
+
+    NodeStack stack = { .capacity = TREE_STACK_SIZE };
+    stack.items = stack.buffer;
+    stackPush(&stack, tree->root);
+    while(stack.top > 0)
+    {
+        const SectorTreeNode *node = &tree->nodes[stack.items[--stack.top]];
+        if(!overlaps(node->bb, box))
+            continue;
+
+        if(node->sector)
+        {
+            fn(node->sector, user);
+            continue;
+        }
+
+        stackPush(&stack, node->left);
+        stackPush(&stack, node->right);
+    }
+
+    stackFree(&stack);
+}
+
+void SectorTreeFree(SectorTree *tree)
+{
+    free(tree->nodes);
+    *tree = (SectorTree){ 0 };
+}
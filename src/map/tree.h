@@ -0,0 +1,12 @@
+#pragma once
+
+#include "../map.h"
+
+// (re)inserts the sector with its current bb
+void SectorTreeUpdate(SectorTree *tree, MapSector *sector);
+void SectorTreeRemove(SectorTree *tree, MapSector *sector);
+// the innermost sector containing pos, that is the one with the smallest box, ties go to the lower index
+MapSector* SectorTreePick(const SectorTree *tree, Vec2 pos);
+// visits every sector whose bb overlaps box
+void SectorTreeQueryBox(const SectorTree *tree, BoundingBox box, MapVisitFn fn, void *user);
+void SectorTreeFree(SectorTree *tree);
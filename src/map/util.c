@@ -4,6 +4,8 @@
 
 #include "../edit.h"
 #include "map.h"
+#include "grid.h"
+#include "index.h"
 #include "remove.h"
 #include "triangulate.h"
 
@@ -97,11 +99,9 @@ bool IsLineFront(MapVertex *v1, MapLine *line)
 
 MapLine* GetMapLine(Map *map, line_t line)
 {
-    for(MapLine *mline = map->headLine; mline; mline = mline->next)
-    {
-        if((vec2_eqv(mline->a->pos, line.a) && vec2_eqv(mline->b->pos, line.b)) ||
-           (vec2_eqv(mline->b->pos, line.a) && vec2_eqv(mline->a->pos, line.b)))
-           return mline;
-    }
-    return NULL;
+    MapVertex *va = VertexGridFind(&map->vertexGrid, line.a);
+    if(!va) return NULL;
+    MapVertex *vb = VertexGridFind(&map->vertexGrid, line.b);
+    if(!vb) return NULL;
+    return LineTableFind(&map->lineTable, va, vb);
 }
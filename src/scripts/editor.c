@@ -2,6 +2,7 @@
 #include "scripts.h"
 
 #include "cglm/types-struct.h"
+#include <stdlib.h>
 #include <string.h>
 
 #include "lua.h"
@@ -33,19 +34,19 @@ static void fillSideData(lua_State *L, Side side)
 {
     lua_pushstring(L, "upper");
     if(side.upperTex)
-        lua_pushstring(L, side.upperTex);
+        lua_pushstring(L, InternedString(side.upperTex));
     else
         lua_pushnil(L);
     lua_settable(L, -3);
     lua_pushstring(L, "middle");
     if(side.middleTex)
-        lua_pushstring(L, side.middleTex);
+        lua_pushstring(L, InternedString(side.middleTex));
     else
         lua_pushnil(L);
     lua_settable(L, -3);
     lua_pushstring(L, "lower");
     if(side.lowerTex)
-        lua_pushstring(L, side.lowerTex);
+        lua_pushstring(L, InternedString(side.lowerTex));
     else
         lua_pushnil(L);
     lua_settable(L, -3);
@@ -132,6 +133,24 @@ static int checkselection_(lua_State *L)
     return 1;
 }
 
+static Vec2 tableVec2(lua_State *L, int table, int i)
+{
+    lua_rawgeti(L, table, i);
+    lua_pushstring(L, "x");
+    lua_gettable(L, -2);
+    float x = lua_tonumber(L, -1);
+    lua_pop(L, 1);
+
+    lua_pushstring(L, "y");
+    lua_gettable(L, -2);
+    float y = lua_tonumber(L, -1);
+    lua_pop(L, 1);
+
+    lua_pop(L, 1);
+
+    return (Vec2){ .x = x, .y = y };
+}
+
 static int insertlines_(lua_State *L)
 {
     EdState *state = lua_touserdata(L, lua_upvalueindex(1));
@@ -145,20 +164,7 @@ static int insertlines_(lua_State *L)
     Vec2 vertices[numVertices];
     for(int i = 0; i < numVertices; ++i)
     {
-        lua_rawgeti(L, 1, i+1);
-        lua_pushstring(L, "x");
-        lua_gettable(L, -2);
-        float x = lua_tonumber(L, -1);
-        lua_pop(L, 1);
-
-        lua_pushstring(L, "y");
-        lua_gettable(L, -2);
-        float y = lua_tonumber(L, -1);
-        lua_pop(L, 1);
-
-        vertices[i] = (Vec2){ .x = x, .y = y };
-
-        lua_pop(L, 1);
+        vertices[i] = tableVec2(L, 1, i+1);
     }
 
     bool res;
@@ -168,11 +174,44 @@ static int insertlines_(lua_State *L)
         res = EditApplyLines(state, numVertices, vertices);
 
     if(!res)
-        LogWarning("Failed too insert all lines, queue full. Added too many intersecting lines?");
+        LogWarning("Failed to insert all lines, the insert was cancelled.");
 
     return 0;
 }
 
+static int insertsegments_(lua_State *L)
+{
+    EdState *state = lua_touserdata(L, lua_upvalueindex(1));
+
+    luaL_argexpected(L, lua_istable(L, 1), 1, "Vec2[]");
+    bool makeSectors = false;
+    if(!lua_isnoneornil(L, 2))
+        makeSectors = lua_toboolean(L, 2);
+
+    // consecutive pairs of vertices are the segments
+    int numSegments = luaL_len(L, 1) / 2;
+    line_t *segments = malloc((numSegments + 1) * sizeof *segments);
+    for(int i = 0; i < numSegments; ++i)
+    {
+        segments[i].a = tableVec2(L, 1, 2*i + 1);
+        segments[i].b = tableVec2(L, 1, 2*i + 2);
+    }
+
+    if(!EditApplySegments(state, numSegments, segments, makeSectors))
+        LogWarning("Failed to insert all segments.");
+
+    free(segments);
+
+    return 0;
+}
+
+static int rebuildsectors_(lua_State *L)
+{
+    EdState *state = lua_touserdata(L, lua_upvalueindex(1));
+    EditRebuildSectors(state);
+    return 0;
+}
+
 void ScriptRegisterEditor(lua_State *L, EdState *state)
 {
     lua_getglobal(L, "Editor");
@@ -181,6 +220,8 @@ void ScriptRegisterEditor(lua_State *L, EdState *state)
         { .name = "GetSelection", .func = getselection_ },
         { .name = "CheckSelection", .func = checkselection_ },
         { .name = "InsertLines", .func = insertlines_ },
+        { .name = "InsertSegments", .func = insertsegments_ },
+        { .name = "RebuildSectors", .func = rebuildsectors_ },
         { NULL, NULL }
     };
     lua_pushlightuserdata(L, state);
@@ -32,6 +32,7 @@ static void BatchCallback(Batch batch, bool lastBatch, void *, void *user)
     }
 
     tc_sort(tc);
+    ClearTextureCache(state);
 
     if(lastBatch)
     {
@@ -126,6 +127,7 @@ void LoadTextures(EdState *state, bool refresh)
 
     if(!refresh)
         tc_unload_all(tc);
+    ClearTextureCache(state);
 
     Async_AbortJob(async);
 
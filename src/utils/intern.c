@@ -0,0 +1,100 @@
+#include "intern.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "hash.h"
+
+#define INTERN_MIN_SLOTS 1024
+
+static Arena internArena = { 0 };
+
+// strings[0] is reserved for the empty id
+static char **strings = NULL;
+static size_t numStrings = 0, capStrings = 0;
+
+// open addressing table of ids, probed by the string hash
+static StringId *slots = NULL;
+static size_t numSlots = 0;
+
+static void insertSlot(StringId *table, size_t size, StringId id)
+{
+    size_t s = hash(strings[id]) & (size - 1);
+    while(table[s] != 0)
+        s = (s + 1) & (size - 1);
+    table[s] = id;
+}
+
+static void growSlots(void)
+{
+    size_t newSize = numSlots == 0 ? INTERN_MIN_SLOTS : numSlots * 2;
+    StringId *table = calloc(newSize, sizeof *table);
+    for(StringId id = 1; id < numStrings; ++id)
+        insertSlot(table, newSize, id);
+    free(slots);
+    slots = table;
+    numSlots = newSize;
+}
+
+StringId FindInternedString(const char *str)
+{
+    if(!str || numSlots == 0) return 0;
+
+    size_t s = hash(str) & (numSlots - 1);
+    while(slots[s] != 0)
+    {
+        if(strcmp(strings[slots[s]], str) == 0)
+            return slots[s];
+        s = (s + 1) & (numSlots - 1);
+    }
+    return 0;
+}
+
+StringId InternString(const char *str)
+{
+    if(!str) return 0;
+
+    StringId existing = FindInternedString(str);
+    if(existing != 0) return existing;
+
+    if(numStrings == 0)
+        numStrings = 1;
+
+    // keep the table at most half full
+    if((numStrings + 1) * 2 > numSlots)
+        growSlots();
+
+    if(numStrings >= capStrings)
+    {
+        capStrings = capStrings == 0 ? INTERN_MIN_SLOTS : capStrings * 2;
+        strings = realloc(strings, capStrings * sizeof *strings);
+        strings[0] = NULL;
+    }
+
+    StringId id = numStrings++;
+    strings[id] = arena_strdup(&internArena, str);
+    insertSlot(slots, numSlots, id);
+    return id;
+}
+
+const char* InternedString(StringId id)
+{
+    if(id == 0 || id >= numStrings) return NULL;
+    return strings[id];
+}
+
+size_t InternedCount(void)
+{
+    return numStrings;
+}
+
+void InternFree(void)
+{
+    arena_free(&internArena);
+    free(strings);
+    free(slots);
+    strings = NULL;
+    slots = NULL;
+    numStrings = capStrings = numSlots = 0;
+}
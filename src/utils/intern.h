@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// id of an interned string, equal strings get the same id, 0 stands for no string
+typedef uint32_t StringId;
+
+StringId InternString(const char *str);
+// like InternString but returns 0 instead of adding unknown strings
+StringId FindInternedString(const char *str);
+const char* InternedString(StringId id);
+size_t InternedCount(void);
+void InternFree(void);
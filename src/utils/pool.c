@@ -0,0 +1,110 @@
+#include "pool.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define POOL_SLAB_SIZE (ARENA_REGION_DEFAULT_CAPACITY * sizeof(uintptr_t))
+
+void PoolInit(Pool *pool, size_t elementSize)
+{
+    PoolRelease(pool);
+    // the free list link is stored in the element itself
+    pool->elementSize = elementSize < sizeof(void*) ? sizeof(void*) : elementSize;
+}
+
+void* PoolAlloc(Pool *pool)
+{
+    assert(pool->elementSize > 0);
+
+    void *element;
+    if(pool->freeList)
+    {
+        element = pool->freeList;
+        pool->freeList = *(void**)element;
+    }
+    else
+    {
+        if(pool->slabUsed == pool->slabCapacity)
+        {
+            pool->slabCapacity = POOL_SLAB_SIZE / pool->elementSize;
+            if(pool->slabCapacity == 0) pool->slabCapacity = 1;
+            pool->slab = arena_alloc(&pool->arena, pool->slabCapacity * pool->elementSize);
+            pool->slabUsed = 0;
+        }
+        element = pool->slab + pool->slabUsed++ * pool->elementSize;
+    }
+
+    memset(element, 0, pool->elementSize);
+    pool->count++;
+    return element;
+}
+
+void PoolFree(Pool *pool, void *element)
+{
+    if(!element) return;
+    *(void**)element = pool->freeList;
+    pool->freeList = element;
+    pool->count--;
+}
+
+void PoolRelease(Pool *pool)
+{
+    arena_free(&pool->arena);
+    size_t elementSize = pool->elementSize;
+    *pool = (Pool){ .elementSize = elementSize };
+}
+
+#define BLOCK_MIN_SIZE 16
+
+// the size class is stored in front of every block, blocks get the same alignment as pool elements
+typedef struct BlockHeader
+{
+    size_t sizeClass;
+} BlockHeader;
+
+static inline size_t blockClassSize(size_t sizeClass)
+{
+    return (size_t)BLOCK_MIN_SIZE << sizeClass;
+}
+
+void* BlockAlloc(BlockHeap *heap, size_t size)
+{
+    size_t sizeClass = 0;
+    while(blockClassSize(sizeClass) < size) sizeClass++;
+    assert(sizeClass < BLOCK_HEAP_CLASSES);
+
+    Pool *pool = &heap->classes[sizeClass];
+    if(pool->elementSize == 0)
+        PoolInit(pool, sizeof(BlockHeader) + blockClassSize(sizeClass));
+
+    BlockHeader *header = PoolAlloc(pool);
+    header->sizeClass = sizeClass;
+    return header + 1;
+}
+
+void* BlockRealloc(BlockHeap *heap, void *block, size_t size)
+{
+    if(!block) return BlockAlloc(heap, size);
+
+    BlockHeader *header = (BlockHeader*)block - 1;
+    size_t oldSize = blockClassSize(header->sizeClass);
+    if(size <= oldSize) return block;
+
+    void *newBlock = BlockAlloc(heap, size);
+    memcpy(newBlock, block, oldSize);
+    BlockFree(heap, block);
+    return newBlock;
+}
+
+void BlockFree(BlockHeap *heap, void *block)
+{
+    if(!block) return;
+    BlockHeader *header = (BlockHeader*)block - 1;
+    PoolFree(&heap->classes[header->sizeClass], header);
+}
+
+void BlockHeapRelease(BlockHeap *heap)
+{
+    for(size_t i = 0; i < BLOCK_HEAP_CLASSES; ++i)
+        PoolRelease(&heap->classes[i]);
+}
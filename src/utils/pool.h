@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "arena.h"
+
+// fixed size element pool carved out of arena slabs, freed elements are reused through an intrusive free list
+typedef struct Pool
+{
+    Arena arena;
+    void *freeList;
+    char *slab;
+    size_t slabUsed, slabCapacity;
+    size_t elementSize, count;
+} Pool;
+
+void PoolInit(Pool *pool, size_t elementSize);
+void* PoolAlloc(Pool *pool);
+void PoolFree(Pool *pool, void *element);
+void PoolRelease(Pool *pool);
+
+#define BLOCK_HEAP_CLASSES 28
+
+// variable sized blocks rounded up to power of two size classes, each class is a pool so releasing the heap only frees slabs
+typedef struct BlockHeap
+{
+    Pool classes[BLOCK_HEAP_CLASSES];
+} BlockHeap;
+
+void* BlockAlloc(BlockHeap *heap, size_t size);
+void* BlockRealloc(BlockHeap *heap, void *block, size_t size);
+void BlockFree(BlockHeap *heap, void *block);
+void BlockHeapRelease(BlockHeap *heap);
@@ -10,6 +10,9 @@
 #include "map.h"
 #include "utils.h"
 #include "../edit.h"
+#include "../map/grid.h"
+#include "../map/hot.h"
+#include "../map/tree.h"
 
 #define DEFAULT_WHITE { 1, 1, 1, 1 }
 #define LINE_DIST 10
@@ -26,7 +29,7 @@ static void SubmitEditData(EdState *state, bool isLoop)
         res = EditApplyLines(state, state->data.editVertexBufferSize, state->data.editVertexBuffer);
 
     if(!res)
-        LogWarning("Failed to insert all lines, too many intersections");
+        LogWarning("Failed to insert all lines, the insert was cancelled.");
 
     state->data.editVertexBufferSize = 0;
 }
@@ -36,55 +39,51 @@ static bool within(Vec2 min, Vec2 max, Vec2 v)
     return v.x >= min.x && v.y >= min.y && v.x <= max.x && v.y <= max.y;
 }
 
+typedef struct RectSelectData
+{
+    EdState *state;
+    BoundingBox box;
+} RectSelectData;
+
+static void selectVertex(void *element, void *user)
+{
+    RectSelectData *data = user;
+    SelectionAdd(data->state, element);
+}
+
+static void selectLine(void *element, void *user)
+{
+    RectSelectData *data = user;
+    MapLine *line = element;
+    const MapHotData *hot = &data->state->map.hot;
+    if(within(data->box.min, data->box.max, hot->lineA[line->slot]) && within(data->box.min, data->box.max, hot->lineB[line->slot]))
+        SelectionAdd(data->state, line);
+}
+
+static void selectSector(void *element, void *user)
+{
+    RectSelectData *data = user;
+    MapSector *sector = element;
+    // the bounding box spans all outer points, so it is inside exactly when all of them are
+    if(within(data->box.min, data->box.max, sector->bb.min) && within(data->box.min, data->box.max, sector->bb.max))
+        SelectionAdd(data->state, sector);
+}
+
 static void RectSelect(EdState *state, bool add)
 {
     Vec2 min = { .x = min(state->data.startDrag.x, state->data.endDrag.x), .y = min(state->data.startDrag.y, state->data.endDrag.y) };
     Vec2 max = { .x = max(state->data.startDrag.x, state->data.endDrag.x), .y = max(state->data.startDrag.y, state->data.endDrag.y) };
 
     if(!add)
-        state->data.numSelectedElements = 0;
+        SelectionClear(state);
 
+    Map *map = &state->map;
+    RectSelectData data = { .state = state, .box = { .min = min, .max = max } };
     switch(state->data.selectionMode)
     {
-    case MODE_VERTEX:
-        {
-            for(MapVertex *vertex = state->map.headVertex; vertex; vertex = vertex->next)
-            {
-                if(within(min, max, vertex->pos))
-                {
-                    state->data.selectedElements[state->data.numSelectedElements++] = vertex;
-                }
-            }
-        }
-        break;
-    case MODE_LINE:
-        {
-            for(MapLine *line = state->map.headLine; line; line = line->next)
-            {
-                if(within(min, max, line->a->pos) && within(min, max, line->b->pos))
-                {
-                    state->data.selectedElements[state->data.numSelectedElements++] = line;
-                }
-            }
-        }
-        break;
-    case MODE_SECTOR:
-        {
-            for(MapSector *sector = state->map.headSector; sector; sector = sector->next)
-            {
-                bool allPointsIn = true;
-                for(size_t i = 0; i < sector->numOuterLines; ++i)
-                {
-                    allPointsIn &= within(min, max, sector->outerLines[i]->a->pos);
-                }
-
-                if(allPointsIn)
-                {
-                    state->data.selectedElements[state->data.numSelectedElements++] = sector;
-                }
-            }
-        }
-        break;
+    case MODE_VERTEX: VertexGridQueryBox(&map->vertexGrid, &map->hot, data.box, selectVertex, &data); break;
+    case MODE_LINE: LineGridQueryBox(&map->lineGrid, data.box, selectLine, &data); break;
+    case MODE_SECTOR: SectorTreeQueryBox(&map->sectorTree, data.box, selectSector, &data); break;
     }
 }
 
@@ -332,26 +331,15 @@ void EditorWindow(bool *p_open, EdState *state)
                         {
                             if(shiftDown)
                             {
-                                bool removed = false;
-                                for(size_t i = 0; i < state->data.numSelectedElements; ++i)
-                                {
-                                    if(state->data.selectedElements[i] == selectedElement)
-                                    {
-                                        memmove(state->data.selectedElements + i, state->data.selectedElements + i + 1, (state->data.numSelectedElements - (i+1)) * sizeof *state->data.selectedElements);
-                                        state->data.numSelectedElements--;
-                                        removed = true;
-                                        break;
-                                    }
-                                }
-                                if(!removed)
-                                {
-                                    state->data.selectedElements[state->data.numSelectedElements++] = selectedElement;
-                                }
+                                if(SelectionContains(state, selectedElement))
+                                    SelectionRemove(state, selectedElement);
+                                else
+                                    SelectionAdd(state, selectedElement);
                             }
                             else
                             {
-                                state->data.numSelectedElements = 1;
-                                state->data.selectedElements[0] = selectedElement;
+                                SelectionClear(state);
+                                SelectionAdd(state, selectedElement);
                             }
                         }
                     }
@@ -390,6 +378,10 @@ void EditorWindow(bool *p_open, EdState *state)
                             MapVertex *tmp = line->b;
                             line->b = line->a;
                             line->a = tmp;
+                            size_t tmpIndex = line->bVertIndex;
+                            line->bVertIndex = line->aVertIndex;
+                            line->aVertIndex = tmpIndex;
+                            HotUpdateLine(&map->hot, line);
                         }
                     }
                 }
@@ -401,7 +393,7 @@ void EditorWindow(bool *p_open, EdState *state)
                     case ESTATE_NORMAL:
                     {
                         state->data.editState = ESTATE_ADDVERTEX;
-                        state->data.numSelectedElements = 0;
+                        SelectionClear(state);
                         state->data.hoveredElement = NULL;
                     }
                     break;
@@ -439,6 +431,7 @@ void EditorWindow(bool *p_open, EdState *state)
                         case MODE_LINE: EditRemoveLines(map, state->data.numSelectedElements, (MapLine**)state->data.selectedElements); break;
                         case MODE_SECTOR: EditRemoveSectors(map, state->data.numSelectedElements, (MapSector**)state->data.selectedElements); break;
                         }
+                        // the removed elements are gone, their flags went with them
                         state->data.numSelectedElements = 0;
                         state->data.hoveredElement = NULL;
                     }
@@ -453,8 +446,7 @@ void EditorWindow(bool *p_open, EdState *state)
                     }
                     else if(state->data.editState == ESTATE_NORMAL)
                     {
-                        if(state->data.numSelectedElements > 0)
-                            state->data.numSelectedElements = 0;
+                        SelectionClear(state);
                     }
                 }
 
@@ -4,15 +4,14 @@
 #include "cimgui.h"
 
 #include "texture_collection.h"
-#include "utils/string.h"
 
 #include "../vecmath.h"
 
 static void SelectElement(EdState *state, void *element, int selectMode)
 {
-    state->data.numSelectedElements = 1;
-    state->data.selectedElements[0] = element;
+    SelectionClear(state);
     state->data.selectionMode = selectMode;
+    SelectionAdd(state, element);
 }
 
 static void GotoPos(EdState *state, Vec2 pos)
@@ -153,15 +152,14 @@ static void SectorProperties(EdState *state)
         igInputInt("Floor Height", &selectedSector->data.floorHeight, 1, 10, 0);
         igInputInt("Ceiling Height", &selectedSector->data.ceilHeight, 1, 10, 0);
 
-        Texture *floorTexture = tc_get(&state->textures, selectedSector->data.floorTex);
+        Texture *floorTexture = tc_get(&state->textures, InternedString(selectedSector->data.floorTex));
         igText("Floor");
         GLuint texId = floorTexture ? floorTexture->texture1 : state->defaultTextures.missingTexture;
         ImVec2 size = floorTexture ? (ImVec2){ floorTexture->width, floorTexture->height } : (ImVec2){ state->defaultTextures.missingTextureWidth, state->defaultTextures.missingTextureHeight };
         igImageButton("floorTexture", (ImTextureRef){ ._TexID = texId }, size, (ImVec2){ 0, 0 }, (ImVec2){ 1, 1, }, (ImVec4){ 0, 0, 0, 0 }, (ImVec4){ 1, 1, 1, 1 });
         if(igIsItemHovered(0) && igIsMouseReleased_Nil(ImGuiMouseButton_Right) && floorTexture)
         {
-            free(selectedSector->data.floorTex);
-            selectedSector->data.floorTex = NULL;
+            selectedSector->data.floorTex = 0;
         }
 
         if(igBeginDragDropTarget())
@@ -169,22 +167,20 @@ static void SectorProperties(EdState *state)
             const ImGuiPayload *payload = igAcceptDragDropPayload("TextureDnD", 0);
             if(payload)
             {
-                free(selectedSector->data.floorTex);
                 Texture *tex = *(Texture**)payload->Data;
-                selectedSector->data.floorTex = CopyString(tex->name);
+                selectedSector->data.floorTex = InternString(tex->name);
             }
             igEndDragDropTarget();
         }
 
-        Texture *ceilTexture = tc_get(&state->textures, selectedSector->data.ceilTex);
+        Texture *ceilTexture = tc_get(&state->textures, InternedString(selectedSector->data.ceilTex));
         igText("Ceiling");
         texId = ceilTexture ? ceilTexture->texture1 : state->defaultTextures.missingTexture;
         size = ceilTexture ? (ImVec2){ ceilTexture->width, ceilTexture->height } : (ImVec2){ state->defaultTextures.missingTextureWidth, state->defaultTextures.missingTextureHeight };
         igImageButton("ceilTexture", (ImTextureRef){ ._TexID = texId }, size, (ImVec2){ 0, 0 }, (ImVec2){ 1, 1, }, (ImVec4){ 0, 0, 0, 0 }, (ImVec4){ 1, 1, 1, 1 });
         if(igIsItemHovered(0) && igIsMouseReleased_Nil(ImGuiMouseButton_Right) && ceilTexture)
         {
-            free(selectedSector->data.floorTex);
-            selectedSector->data.floorTex = NULL;
+            selectedSector->data.ceilTex = 0;
         }
 
         if(igBeginDragDropTarget())
@@ -192,9 +188,8 @@ static void SectorProperties(EdState *state)
             const ImGuiPayload *payload = igAcceptDragDropPayload("TextureDnD", 0);
             if(payload)
             {
-                free(selectedSector->data.ceilTex);
                 Texture *tex = *(Texture**)payload->Data;
-                selectedSector->data.ceilTex = CopyString(tex->name);
+                selectedSector->data.ceilTex = InternString(tex->name);
             }
             igEndDragDropTarget();
         }